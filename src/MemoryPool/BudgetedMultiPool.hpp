@@ -0,0 +1,125 @@
+#ifndef KOKKOS_MEMORY_POOL_BUDGETEDMULTIPOOL_HPP
+#define KOKKOS_MEMORY_POOL_BUDGETEDMULTIPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <mutex>
+#include <new>
+#include <ostream>
+
+#include "MemoryPool.hpp"
+
+// Thread safe MultiPool that never has more than budgetChunks chunks allocated at once. Requests that do not fit wait
+// in a FIFO queue and are completed from deallocate strictly in arrival order, so a large request is never starved by
+// smaller ones behind it, and nothing bypasses the queue while it is non-empty. The budget bounds allocated chunks;
+// fragmentation can still make the sub-pools somewhat larger. Waiters still queued when the pool is destroyed see a
+// std::future_error (broken promise), and requests larger than the whole budget fail with std::bad_alloc.
+template<typename MemorySpace = Kokkos::HostSpace>
+class BudgetedMultiPool {
+public:
+    BudgetedMultiPool(size_t initialChunks, size_t budgetChunks) : pool(initialChunks), budgetChunks(budgetChunks) {}
+
+    BudgetedMultiPool(const BudgetedMultiPool&) = delete;
+    BudgetedMultiPool& operator=(const BudgetedMultiPool&) = delete;
+
+    // Returns nullptr instead of waiting
+    uint8_t* tryAllocate(size_t n) {
+        std::lock_guard lock(mutex);
+
+        size_t requiredChunks = BasicMemoryPool<MemorySpace>::getRequiredChunks(n);
+        return waiters.empty() && fitsInBudget(requiredChunks) ? allocateWithinBudget(n, requiredChunks) : nullptr;
+    }
+
+    std::future<uint8_t*> allocateAsync(size_t n) {
+        std::promise<uint8_t*> promise;
+        std::future<uint8_t*> future = promise.get_future();
+        size_t requiredChunks = BasicMemoryPool<MemorySpace>::getRequiredChunks(n);
+
+        if (requiredChunks > budgetChunks) {
+            promise.set_exception(std::make_exception_ptr(std::bad_alloc()));
+            return future;
+        }
+
+        std::lock_guard lock(mutex);
+
+        if (waiters.empty() && fitsInBudget(requiredChunks)) {
+            promise.set_value(allocateWithinBudget(n, requiredChunks));
+        } else {
+            waiters.push_back({n, requiredChunks, std::move(promise)});
+        }
+
+        return future;
+    }
+
+    void deallocate(uint8_t* data) {
+        std::lock_guard lock(mutex);
+
+        allocatedChunks -= pool.getAllocationSize(data);
+        pool.deallocate(data);
+
+        // Strict FIFO, stop at the first waiter that still does not fit
+        while (!waiters.empty() && fitsInBudget(waiters.front().requiredChunks)) {
+            Waiter& waiter = waiters.front();
+            waiter.promise.set_value(allocateWithinBudget(waiter.n, waiter.requiredChunks));
+            waiters.pop_front();
+        }
+    }
+
+    template<typename DataType>
+    std::future<Kokkos::View<DataType*, MemorySpace>> allocateViewAsync(size_t n) {
+        return std::async(std::launch::deferred, [n, future = allocateAsync(n * sizeof(DataType))]() mutable {
+            return Kokkos::View<DataType*, MemorySpace>(reinterpret_cast<DataType*>(future.get()), n);
+        });
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const BudgetedMultiPool &budgetedPool) {
+        std::lock_guard lock(budgetedPool.mutex);
+        return os << budgetedPool.pool;
+    }
+
+    size_t getBudget() const { return budgetChunks; }
+    unsigned getNumWaiters() const { return withLock([this] { return waiters.size(); }); }
+
+    unsigned getNumAllocations() const { return withLock([this] { return pool.getNumAllocations(); }); }
+    unsigned getNumFreeChunks() const { return withLock([this] { return pool.getNumFreeChunks(); }); }
+    unsigned getNumAllocatedChunks() const { return withLock([this] { return allocatedChunks; }); }
+    unsigned getNumChunks() const { return withLock([this] { return pool.getNumChunks(); }); }
+    unsigned getNumFreeFragments() const { return withLock([this] { return pool.getNumFreeFragments(); }); }
+
+private:
+    struct Waiter {
+        size_t n;
+        size_t requiredChunks;
+        std::promise<uint8_t*> promise;
+    };
+
+    bool fitsInBudget(size_t requiredChunks) const {
+        return allocatedChunks + requiredChunks <= budgetChunks;
+    }
+
+    uint8_t* allocateWithinBudget(size_t n, size_t requiredChunks) {
+        allocatedChunks += requiredChunks;
+        return pool.allocate(n);
+    }
+
+    template<typename Getter>
+    unsigned withLock(Getter getter) const {
+        std::lock_guard lock(mutex);
+        return getter();
+    }
+
+    mutable std::mutex mutex;
+    BasicMultiPool<MemorySpace> pool;
+    size_t budgetChunks;
+    size_t allocatedChunks = 0;
+    std::list<Waiter> waiters;
+};
+
+#endif //KOKKOS_MEMORY_POOL_BUDGETEDMULTIPOOL_HPP
@@ -0,0 +1,138 @@
+#include <cassert>
+
+#include "InstancePool.hpp"
+
+InstanceMultiPool::InstancePool::InstancePool(size_t initialChunks, HostMultiPool::PoolInitializer initializer) : pool(initialChunks, std::move(initializer)) {}
+
+InstanceMultiPool::InstanceMultiPool(std::vector<uint32_t> instanceIds, size_t initialChunksPerInstance, size_t maxChunksPerInstance)
+    : maxChunksPerInstance(maxChunksPerInstance) {
+    for (uint32_t instanceId : instanceIds) {
+        unsigned index = instances.size();
+
+        if (!instanceIndices.emplace(instanceId, index).second) {
+            continue;
+        }
+
+        instances.push_back(std::make_unique<InstancePool>(initialChunksPerInstance, [this, index](HostMemoryPool& pool) {
+            registerPool(pool, index);
+        }));
+    }
+}
+
+void InstanceMultiPool::registerPool(HostMemoryPool &pool, unsigned instanceIndex) {
+    std::unique_lock lock(rangesMutex);
+    ranges[pool.getBaseAddress()] = {pool.getBaseAddress() + pool.getSizeInBytes(), instanceIndex};
+}
+
+uint8_t *InstanceMultiPool::allocate(size_t n, unsigned instanceIndex) {
+    auto& instancePool = *instances.at(instanceIndex);
+
+    {
+        std::lock_guard lock(instancePool.mutex);
+
+        if (uint8_t* ptr = instancePool.pool.tryAllocate(n)) {
+            return ptr;
+        }
+
+        if (maxChunksPerInstance == 0 || instancePool.pool.getNumChunks() < maxChunksPerInstance) {
+            return instancePool.pool.allocate(n);
+        }
+    }
+
+    if (uint8_t* ptr = borrow(n, instanceIndex)) {
+        return ptr;
+    }
+
+    // No instance has room left, so growing past the limit is unavoidable
+    std::lock_guard lock(instancePool.mutex);
+    return instancePool.pool.allocate(n);
+}
+
+uint8_t *InstanceMultiPool::borrow(size_t n, unsigned instanceIndex) {
+    for (unsigned offset = 1; offset < instances.size(); offset++) {
+        auto& lender = *instances[(instanceIndex + offset) % instances.size()];
+
+        std::lock_guard lock(lender.mutex);
+        if (uint8_t* ptr = lender.pool.tryAllocate(n)) {
+            return ptr;
+        }
+    }
+
+    return nullptr;
+}
+
+void InstanceMultiPool::deallocate(uint8_t *data) {
+    auto& instancePool = *instances[getInstanceOf(data)];
+
+    std::lock_guard lock(instancePool.mutex);
+    instancePool.pool.deallocate(data);
+}
+
+unsigned InstanceMultiPool::getInstanceOf(const uint8_t *data) const {
+    std::shared_lock lock(rangesMutex);
+
+    auto rangeItr = ranges.upper_bound(data);
+    assert(rangeItr != ranges.begin());
+    rangeItr--;
+
+    auto [end, instanceIndex] = rangeItr->second;
+    assert(data < end);
+
+    return instanceIndex;
+}
+
+unsigned InstanceMultiPool::getIndexOf(uint32_t instanceId) const {
+    return instanceIndices.at(instanceId);
+}
+
+unsigned InstanceMultiPool::getNumInstances() const {
+    return instances.size();
+}
+
+template<typename Func>
+unsigned InstanceMultiPool::sumOverInstances(Func func) const {
+    unsigned sum = 0;
+
+    for (const auto& instancePool : instances) {
+        std::lock_guard lock(instancePool->mutex);
+        sum += func(instancePool->pool);
+    }
+
+    return sum;
+}
+
+unsigned InstanceMultiPool::getNumAllocations() const {
+    return sumOverInstances([](const HostMultiPool& pool) { return pool.getNumAllocations(); });
+}
+
+unsigned InstanceMultiPool::getNumFreeChunks() const {
+    return sumOverInstances([](const HostMultiPool& pool) { return pool.getNumFreeChunks(); });
+}
+
+unsigned InstanceMultiPool::getNumAllocatedChunks() const {
+    return sumOverInstances([](const HostMultiPool& pool) { return pool.getNumAllocatedChunks(); });
+}
+
+unsigned InstanceMultiPool::getNumChunks() const {
+    return sumOverInstances([](const HostMultiPool& pool) { return pool.getNumChunks(); });
+}
+
+unsigned InstanceMultiPool::getNumFreeFragments() const {
+    return sumOverInstances([](const HostMultiPool& pool) { return pool.getNumFreeFragments(); });
+}
+
+unsigned InstanceMultiPool::getNumChunks(unsigned instanceIndex) const {
+    const auto& instancePool = *instances.at(instanceIndex);
+
+    std::lock_guard lock(instancePool.mutex);
+    return instancePool.pool.getNumChunks();
+}
+
+std::ostream &operator<<(std::ostream &os, const InstanceMultiPool &pool) {
+    for (unsigned index = 0; index < pool.instances.size(); index++) {
+        std::lock_guard lock(pool.instances[index]->mutex);
+        os << "Instance " << index << ": " << pool.instances[index]->pool << '\n';
+    }
+
+    return os;
+}
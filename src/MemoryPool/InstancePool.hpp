@@ -0,0 +1,95 @@
+#ifndef KOKKOS_MEMORY_POOL_INSTANCEPOOL_HPP
+#define KOKKOS_MEMORY_POOL_INSTANCEPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+
+// Keeps separate HostMultiPools for each execution space instance, e.g. the partitions returned by
+// Kokkos::Experimental::partition_space, so concurrently running partitions neither contend on one lock nor share
+// cache lines. Each instance grows its own sub-pools until they hold maxChunksPerInstance chunks. Past that, free
+// space is borrowed from the pools of other instances before growing any further. Zero means no limit, in which case
+// instances never borrow. Instances sharing an id, as every instance of a backend without real instances does, share
+// one pool, so the pool may hold fewer instances than it was built with.
+class InstanceMultiPool {
+public:
+    template<typename ExecutionSpace>
+    InstanceMultiPool(const std::vector<ExecutionSpace>& instances, size_t initialChunksPerInstance, size_t maxChunksPerInstance = 0)
+        : InstanceMultiPool(getInstanceIds(instances), initialChunksPerInstance, maxChunksPerInstance) {}
+
+    template<typename ExecutionSpace>
+    uint8_t* allocate(size_t n, const ExecutionSpace& instance) {
+        return allocate(n, getIndexOf(instance.impl_instance_id()));
+    }
+
+    uint8_t* allocate(size_t n, unsigned instanceIndex);
+    void deallocate(uint8_t* data);
+
+    template<typename DataType, typename ExecutionSpace>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n, const ExecutionSpace& instance) {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType), instance)), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const InstanceMultiPool &pool);
+
+    unsigned getNumInstances() const;
+    unsigned getIndexOf(uint32_t instanceId) const; // Throws std::out_of_range for instances the pool was not built with
+    unsigned getInstanceOf(const uint8_t* data) const; // Index of the instance whose sub-pools hold data
+
+    unsigned getNumAllocations() const;
+    unsigned getNumFreeChunks() const;
+    unsigned getNumAllocatedChunks() const;
+    unsigned getNumChunks() const;
+    unsigned getNumFreeFragments() const;
+    unsigned getNumChunks(unsigned instanceIndex) const;
+
+private:
+    // Padded so the locks of different instances never share a cache line
+    struct alignas(64) InstancePool {
+        InstancePool(size_t initialChunks, HostMultiPool::PoolInitializer initializer);
+
+        mutable std::mutex mutex;
+        HostMultiPool pool;
+    };
+
+    InstanceMultiPool(std::vector<uint32_t> instanceIds, size_t initialChunksPerInstance, size_t maxChunksPerInstance);
+
+    template<typename ExecutionSpace>
+    static std::vector<uint32_t> getInstanceIds(const std::vector<ExecutionSpace>& instances) {
+        std::vector<uint32_t> instanceIds;
+
+        for (const auto& instance : instances) {
+            instanceIds.push_back(instance.impl_instance_id());
+        }
+
+        return instanceIds;
+    }
+
+    uint8_t* borrow(size_t n, unsigned instanceIndex);
+    void registerPool(HostMemoryPool& pool, unsigned instanceIndex);
+
+    template<typename Func>
+    unsigned sumOverInstances(Func func) const;
+
+    size_t maxChunksPerInstance;
+    std::map<uint32_t, unsigned> instanceIndices; // Instance id -> index into instances
+    std::vector<std::unique_ptr<InstancePool>> instances;
+
+    mutable std::shared_mutex rangesMutex;
+    std::map<const uint8_t*, std::pair<const uint8_t*, unsigned>> ranges; // Start of sub-pool -> end and instance
+};
+
+#endif //KOKKOS_MEMORY_POOL_INSTANCEPOOL_HPP
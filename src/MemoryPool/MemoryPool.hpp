@@ -5,15 +5,37 @@
 #ifndef KOKKOS_MEMORY_POOL_MEMORYPOOL_HPP
 #define KOKKOS_MEMORY_POOL_MEMORYPOOL_HPP
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <map>
+#include <optional>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <ostream>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "Kokkos_Core.hpp"
 
+#include "PoolSnapshot.hpp"
+
 using IndexPair = std::pair<size_t, size_t>;
 using FreeListT = std::list<IndexPair>;
 
@@ -30,65 +52,1569 @@ public:
 using MultiSetBySizeT = std::multiset<IndexPair, CompareFreeIndices>;
 using SetByIndexT = std::set<IndexPair>;
 
-class MemoryPool {
+// Which free run an allocation is carved from. Best fit takes the smallest run that fits, lowest address first. First
+// fit takes the lowest addressed run that fits, next fit the first one at or after where the previous allocation
+// ended, wrapping around, and worst fit always the largest run.
+enum class PlacementPolicy {
+    BestFit,
+    FirstFit,
+    NextFit,
+    WorstFit
+};
+
+struct PoolOptions {
+    // Zero a new pool page by page in parallel on the host instead of letting the View initialize it, so each page is
+    // first touched by a thread of the execution space that will use it and first use inside a kernel never faults.
+    // Host pools only.
+    bool prefault = false;
+    // Also mlock the pages so they stay resident. Locked pages stay locked until the pool is destroyed, and
+    // purgeFreeChunks leaves locked pools alone. The partial pages at the edges of the pool are shared with other heap
+    // memory, so they are not locked.
+    bool lock = false;
+    // Start allocations of at least coloringThreshold bytes on rotating chunk offsets, cacheColors of them, so large
+    // views of the same size do not all map to the same cache sets. 32 colors cover a 4 KiB page, 0 or 1 disables it.
+    // The chunks skipped to reach a color are held by the allocation after them and count as allocated until it is
+    // freed, so they never linger as fragments. Allocations that only fit unshifted are placed uncolored.
+    unsigned cacheColors = 0;
+    size_t coloringThreshold = 4096;
+    PlacementPolicy placement = PlacementPolicy::BestFit;
+    // Keep up to quickListDepth recently freed blocks of every size up to maxQuickListChunks chunks aside, uncoalesced,
+    // and hand them straight back to allocations of exactly that size. A list is merged into the free sets when it
+    // overflows, and all of them when an allocation finds no free run. 0 disables quick lists.
+    unsigned quickListDepth = 0;
+    size_t maxQuickListChunks = 8;
+    // Buffer up to this many frees and merge them into the free sets in one sorted sweep, once the buffer is full or an
+    // allocation finds no free run, instead of coalescing on every deallocation. 0 coalesces right away.
+    size_t deferredFrees = 0;
+    // Build sub-pools without launching any Kokkos kernel, clearing host memory with a plain memset on the calling
+    // thread. Needed by MultiPools that may grow on threads Kokkos did not start. Host pools only.
+    bool clearWithMemset = false;
+};
+
+// Keeps a range of pages mlocked for as long as it lives. Moving hands the lock over, so a pool moved into a MultiPool
+// still unlocks its pages exactly once.
+class PageLock {
+public:
+    PageLock() = default;
+    // Locks the pages lying wholly inside the range. Locks nothing if there are none or mlock fails, e.g. beyond
+    // RLIMIT_MEMLOCK.
+    PageLock(void* data, size_t size);
+    ~PageLock();
+
+    PageLock(PageLock&& other) noexcept;
+    PageLock& operator=(PageLock&& other) noexcept;
+
+    bool isLocked() const;
+
+private:
+    void unlock();
+
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+template<typename MemorySpace>
+class BasicMemoryPool {
 public:
-    explicit MemoryPool(size_t numChunks);
+    static_assert(Kokkos::is_memory_space<MemorySpace>::value, "BasicMemoryPool requires a Kokkos memory space");
+
+    using memory_space = MemorySpace;
+
+    explicit BasicMemoryPool(size_t numChunks, const PoolOptions& options = {});
+    // Builds a pool on memory from allocateMemory, which may have been allocated on another thread. Zeroing, unless
+    // zeroed says the memory is all zero already, prefaulting and locking happen on the calling thread.
+    BasicMemoryPool(Kokkos::View<uint8_t*, MemorySpace> memory, const PoolOptions& options, bool zeroed);
+
+    // Pools own their memory and its page lock, so they can only be moved. Assigning would free the memory before
+    // unlocking it.
+    BasicMemoryPool(BasicMemoryPool&&) noexcept = default;
+    BasicMemoryPool& operator=(BasicMemoryPool&&) = delete;
 
     uint8_t* allocate(size_t n);
+    uint8_t* allocateZeroed(size_t n); // Only clears chunks that may have been written since the pool was created
+    uint8_t* allocateAt(IndexPair indices); // Returns nullptr unless every chunk in [begin, end) is free
     void deallocate(uint8_t* data);
+    void deallocate(uint8_t* data, size_t n); // n must be the size the block was allocated with
+
+    // Keeps the chunks needed for n bytes at data allocated and turns the rest into an allocation of its own, which is
+    // returned. Returns nullptr when nothing is left over.
+    uint8_t* splitAllocation(uint8_t* data, size_t n);
+
+    size_t purgeFreeChunks(); // Returns whole pages of dirty free chunks to the OS, which makes them known zero
+
+    // Lets maintenance work clear free memory without holding the allocator's lock. A taken run is neither free nor
+    // allocated until it is returned, at which point it is marked clean and merged back into the free sets.
+    std::optional<IndexPair> takeDirtyFreeRun(size_t maxChunks);
+    void returnCleanRun(IndexPair indices);
 
-    friend std::ostream &operator<<(std::ostream &os, const MemoryPool &pool);
+    std::vector<IndexPair> getAllocationIndices() const;
+    std::vector<IndexPair> getAllocatedRuns() const; // Gaps between free runs, each may hold several allocations and blocks not merged back yet
+    size_t getAllocationSize(uint8_t* data) const; // In chunks
+
+    template<typename M>
+    friend std::ostream &operator<<(std::ostream &os, const BasicMemoryPool<M> &pool);
 
     unsigned getNumAllocations() const;
     unsigned getNumFreeChunks() const;
     unsigned getNumAllocatedChunks() const;
     unsigned getNumChunks() const;
     unsigned getNumFreeFragments() const;
+    unsigned getNumDirtyFreeChunks() const;
+
+    uint8_t* getBaseAddress() const;
+    size_t getSizeInBytes() const;
+    bool isLocked() const;
+    std::chrono::nanoseconds getPrefaultTime() const; // Spent prefaulting and locking at construction
 
     static constexpr size_t DEFAULT_CHUNK_SIZE = 128;
-    static size_t getRequiredChunks(size_t n);
+    static constexpr size_t CHUNK_ALIGNMENT = 64; // All Kokkos guarantees for the View backing the pool
+    static size_t getRequiredChunks(size_t n); // At least one, so every allocation has a distinct start
+    static Kokkos::View<uint8_t*, MemorySpace> allocateMemory(size_t numChunks); // Uninitialized, so it launches no kernel
 
 private:
     std::pair<MultiSetBySizeT::iterator, SetByIndexT::iterator> insertIntoSets(IndexPair indices);
     void removeFromSets(IndexPair indices);
 
-    Kokkos::View<uint8_t*> pool;
+    std::optional<IndexPair> findFreeRun(size_t minChunks) const; // According to the placement policy
+    std::optional<IndexPair> takeFreeChunks(size_t requestedChunks);
+    std::optional<IndexPair> takeColoredChunks(size_t requestedChunks);
+    void takeFromFreeRun(IndexPair freeRun, IndexPair taken);
+    std::optional<IndexPair> takeFromQuickList(size_t requestedChunks);
+    bool pushToQuickList(IndexPair indices); // Returns false when the block has to be coalesced right away
+    void flushQuickList(size_t numChunks);
+    void flushQuickLists();
+    void deferFree(IndexPair indices);
+    void coalesceDeferredFrees();
+    void mergeHeldBlocks(); // Moves quick listed blocks and deferred frees into the free sets
+    uint8_t* recordAllocation(IndexPair indices);
+    void releaseAllocation(IndexPair indices);
+    void freeChunks(IndexPair chunkIndices);
+    size_t getChunkIndex(const uint8_t* data) const;
+
+    void markDirty(IndexPair indices);
+    std::vector<IndexPair> clearDirty(IndexPair indices); // Returns the sub-ranges that were dirty
+    void zeroDirtyChunks(IndexPair indices);
+
+    void prefault(bool lockPages, bool withMemset);
+
+    Kokkos::View<uint8_t*, MemorySpace> pool;
     MultiSetBySizeT freeSetBySize; // For finding free chunks logarithmically
     SetByIndexT freeSetByIndex; // For merging adjacent free chunks
-    std::map<uint8_t*, IndexPair> allocations;
+    // Disjoint ranges that may be non-zero. Everything else is still zero from construction. Blocks are marked when they
+    // are merged into the free sets rather than when allocated, so allocation does not pay for it, which means only the
+    // free chunks in here are meaningful.
+    SetByIndexT dirtyChunks;
+    std::vector<size_t> allocationEnds; // End index of the allocation starting at each chunk, 0 where none starts
+    size_t numAllocations = 0;
+    size_t numAllocatedChunks = 0;
+    size_t numFreeChunks = 0; // Kept up to date by insertIntoSets and removeFromSets
+    PageLock pageLock; // Declared after pool, so the pages are unlocked before the View frees them
+    std::chrono::nanoseconds prefaultTime = std::chrono::nanoseconds::zero();
+
+    unsigned cacheColors;
+    size_t coloringThreshold;
+    unsigned nextColor = 0;
+    std::map<size_t, size_t> colorPadding; // Begin index of a colored allocation -> chunks skipped in front of it
+
+    PlacementPolicy placement;
+    size_t nextFitIndex = 0; // Where the previous allocation ended, for next fit
+
+    unsigned quickListDepth;
+    std::vector<std::vector<size_t>> quickLists; // Start indices of freed blocks, indexed by their size in chunks - 1
+    size_t numQuickListChunks = 0; // Free, but not in the free sets
+
+    size_t maxDeferredFrees;
+    std::vector<IndexPair> deferredFrees;
+    size_t numDeferredChunks = 0; // Free, but not in the free sets
 };
 
-class MultiPool {
+template<typename MemorySpace>
+class BasicMultiPool {
 public:
-    explicit MultiPool(size_t initialChunks);
+    using memory_space = MemorySpace;
+    using PoolT = BasicMemoryPool<MemorySpace>;
+    // Run on every sub-pool right after it is added to the MultiPool, on the thread that added it
+    using PoolInitializer = std::function<void(PoolT&)>;
+
+    explicit BasicMultiPool(size_t initialChunks, PoolInitializer initializer = {});
+    BasicMultiPool(size_t initialChunks, const PoolOptions& options, PoolInitializer initializer = {}); // Options apply to every sub-pool
+
+    void setPoolInitializer(PoolInitializer initializer);
+
+    // When the free fraction drops below freeFraction after an allocation, the next sub-pool is constructed on a
+    // background thread and adopted by a later allocation once it is ready. Zero disables pre-growth.
+    void setLowWaterMark(double freeFraction);
+    bool isGrowing() const;
+    void waitForGrowth();
 
     uint8_t* allocate(size_t n);
+    uint8_t* allocateZeroed(size_t n);
+    uint8_t* tryAllocate(size_t n); // Only uses existing sub-pools, returns nullptr instead of growing
+    uint8_t* tryAllocateZeroed(size_t n);
     void deallocate(uint8_t* data);
+    void deallocate(uint8_t* data, size_t n); // n must be the size the block was allocated with
+
+    // Stream-ordered deallocation. The block may still be in use by work queued on the instance, so it is only returned
+    // to the free sets once that instance is fenced through this pool. Until then allocating on the same instance can
+    // reuse it right away, since anything the new owner launches there runs after the work of the previous owner.
+    template<typename ExecutionSpace>
+    uint8_t* allocate(size_t n, const ExecutionSpace& instance);
+    template<typename ExecutionSpace>
+    void deallocateAsync(uint8_t* data, const ExecutionSpace& instance);
+    template<typename ExecutionSpace>
+    void fence(const ExecutionSpace& instance);
+    void fence(); // Fences every execution space and releases all pending deallocations
 
     template<typename DataType>
-    Kokkos::View<DataType*> allocateView(size_t n) {
-        return Kokkos::View<DataType*>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType))), n);
+    Kokkos::View<DataType*, MemorySpace> allocateView(size_t n, bool zeroed = false) {
+        uint8_t* ptr = zeroed ? allocateZeroed(n * sizeof(DataType)) : allocate(n * sizeof(DataType));
+        return Kokkos::View<DataType*, MemorySpace>(reinterpret_cast<DataType*>(ptr), n);
     }
 
-    template<typename DataType>
-    void deallocateView(Kokkos::View<DataType*> view) {
-        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    template<typename DataType, typename ExecutionSpace,
+            typename = std::enable_if_t<Kokkos::is_execution_space<ExecutionSpace>::value>>
+    Kokkos::View<DataType*, MemorySpace> allocateView(size_t n, const ExecutionSpace& instance) {
+        uint8_t* ptr = allocate(n * sizeof(DataType), instance);
+        return Kokkos::View<DataType*, MemorySpace>(reinterpret_cast<DataType*>(ptr), n);
+    }
+
+    // The view must span the whole allocation, as returned by allocateView
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        static_assert(std::is_same_v<typename Kokkos::View<DataType*, Properties...>::memory_space, MemorySpace>,
+                "View must reside in the memory space of the pool");
+        deallocate(reinterpret_cast<uint8_t*>(view.data()), view.size() * sizeof(DataType));
+    }
+
+    // Reserves one contiguous block for a whole batch, given the bytes needed by every index. A parallel scan on the
+    // memory space's execution space writes where each index's buffer starts into offsets, which needs
+    // sizes.extent(0) + 1 entries, the last being the size of the batch. Buffers are aligned to alignment, a power of
+    // two no larger than the alignment of a chunk. Deallocating the returned pointer frees the whole batch.
+    template<typename SizesView, typename OffsetsView>
+    uint8_t* allocateBulk(const SizesView& sizes, const OffsetsView& offsets, size_t alignment = alignof(std::max_align_t));
+
+    template<typename ExecutionSpace, typename DataType, typename... Properties>
+    void deallocateViewAsync(Kokkos::View<DataType*, Properties...> view, const ExecutionSpace& instance) {
+        static_assert(std::is_same_v<typename Kokkos::View<DataType*, Properties...>::memory_space, MemorySpace>,
+                "View must reside in the memory space of the pool");
+        deallocateAsync(reinterpret_cast<uint8_t*>(view.data()), instance);
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const MultiPool &pool);
+    // Writes the pool layout and the contents of allocated runs only. Snapshotting fences first, so queued work has
+    // finished writing and pending deallocations are released rather than recorded as live. Restoring replaces every
+    // sub-pool, invalidating outstanding allocations, and returns where each allocation recorded in the snapshot now lives.
+    // A snapshot that cannot be read throws and leaves the pool as it was.
+    void snapshot(const std::string& path, unsigned numThreads = std::thread::hardware_concurrency());
+    std::map<uint8_t*, uint8_t*> restore(const std::string& path, unsigned numThreads = std::thread::hardware_concurrency());
+
+    template<typename M>
+    friend std::ostream &operator<<(std::ostream &os, const BasicMultiPool<M> &pool);
 
     unsigned getNumAllocations() const;
     unsigned getNumFreeChunks() const;
     unsigned getNumAllocatedChunks() const;
     unsigned getNumChunks() const;
     unsigned getNumFreeFragments() const;
+    unsigned getNumDirtyFreeChunks() const;
+    unsigned getNumPendingDeallocations() const; // Still counted as allocated until released by a fence
+    size_t getAllocationSize(uint8_t* data) const; // In chunks
     size_t getChunkSize() const;
+    std::chrono::nanoseconds getPrefaultTime() const; // Summed over every sub-pool
+
+    size_t purgeFreeChunks();
+
+    struct DirtyRun {
+        PoolT* pool;
+        IndexPair indices;
+    };
+
+    // See BasicMemoryPool::takeDirtyFreeRun. Runs stay valid until returned, but not across restore.
+    std::optional<DirtyRun> takeDirtyFreeRun(size_t maxChunks);
+    void returnCleanRun(const DirtyRun& run);
 
 private:
-    using PoolListT = std::list<MemoryPool>;
+    using PoolListT = std::list<PoolT>;
+
+    // Memory for a sub-pool that has not been built yet, and whether it was already cleared
+    struct SubPoolMemory {
+        Kokkos::View<uint8_t*, MemorySpace> memory;
+        bool zeroed;
+    };
+
+    void addPool(size_t numChunks);
+    static SubPoolMemory allocateSubPoolMemory(size_t numChunks, bool clearOnHost);
+    void registerPool(typename PoolListT::iterator poolItr);
+    typename PoolListT::iterator findPool(const uint8_t* data) const;
+    uint8_t* allocateFromPools(size_t n, bool zeroed);
+    uint8_t* allocateFromExistingPools(size_t n, bool zeroed);
+    uint8_t* allocateFromPool(typename PoolListT::iterator poolItr, size_t n, bool zeroed);
+
+    unsigned getLargestPoolSize() const;
+    void growIfBelowLowWaterMark();
+    bool adoptGrownPool(bool wait);
 
     PoolListT pools;
-    std::map<uint8_t*, PoolListT::iterator> allocations;
+    std::map<const uint8_t*, typename PoolListT::iterator> poolsByAddress; // Keyed by base address
+    PoolInitializer poolInitializer;
+    PoolOptions poolOptions;
+
+    struct PendingDeallocation {
+        uint8_t* data;
+        size_t numChunks;
+    };
+
+    std::map<uint32_t, std::vector<PendingDeallocation>> pendingDeallocations; // By execution space instance id
+
+    double lowWaterMark = 0;
+    // Only the memory is allocated on the growth thread, the sub-pool is built by whichever call adopts it. Destroyed
+    // first, which waits for any growth still in flight.
+    std::future<SubPoolMemory> grownPool;
 };
 
+using MemoryPool = BasicMemoryPool<Kokkos::DefaultExecutionSpace::memory_space>;
+using MultiPool = BasicMultiPool<Kokkos::DefaultExecutionSpace::memory_space>;
+
+using HostMemoryPool = BasicMemoryPool<Kokkos::HostSpace>;
+using HostMultiPool = BasicMultiPool<Kokkos::HostSpace>;
+
+template<typename MemorySpace>
+BasicMemoryPool<MemorySpace>::BasicMemoryPool(size_t numChunks, const PoolOptions& options)
+        : BasicMemoryPool(allocateMemory(numChunks), options, false) {}
+
+template<typename MemorySpace>
+BasicMemoryPool<MemorySpace>::BasicMemoryPool(Kokkos::View<uint8_t*, MemorySpace> memory, const PoolOptions& options, bool zeroed)
+        : pool(std::move(memory)), allocationEnds(pool.size() / DEFAULT_CHUNK_SIZE, 0), cacheColors(options.cacheColors),
+          coloringThreshold(options.coloringThreshold), placement(options.placement), quickListDepth(options.quickListDepth),
+          maxDeferredFrees(options.deferredFrees) {
+    insertIntoSets({0, getNumChunks()});
+    deferredFrees.reserve(maxDeferredFrees);
+
+    if (quickListDepth) {
+        quickLists.resize(options.maxQuickListChunks);
+
+        for (auto& quickList : quickLists) {
+            quickList.reserve(quickListDepth);
+        }
+    }
+
+    // Every chunk is known zero from here on, see dirtyChunks
+    if (std::is_same_v<MemorySpace, Kokkos::HostSpace> && (options.prefault || options.lock)) {
+        auto start = std::chrono::steady_clock::now();
+
+        if (zeroed) {
+            // Whoever zeroed the memory touched every page already
+            pageLock = options.lock ? PageLock(pool.data(), pool.size()) : PageLock();
+        } else {
+            prefault(options.lock, options.clearWithMemset);
+        }
+
+        prefaultTime = std::chrono::steady_clock::now() - start;
+    } else if (!zeroed) {
+        Kokkos::deep_copy(pool, uint8_t{0});
+    }
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::prefault(bool lockPages, bool withMemset) {
+    if constexpr (std::is_same_v<MemorySpace, Kokkos::HostSpace>) {
+#ifdef __linux__
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+#else
+        size_t pageSize = 4096;
+#endif
+        uint8_t* data = pool.data();
+        size_t size = pool.size();
+
+        // The memory is uninitialized, so this is both the first touch and what makes the pool start out zero
+        if (withMemset) {
+            std::memset(data, 0, size);
+        } else {
+            Kokkos::parallel_for("BasicMemoryPool::prefault", Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, (size + pageSize - 1) / pageSize),
+                [=](size_t page) {
+                size_t begin = page * pageSize;
+                std::memset(data + begin, 0, std::min(pageSize, size - begin));
+            });
+
+            Kokkos::DefaultHostExecutionSpace().fence("BasicMemoryPool::prefault");
+        }
+
+        if (lockPages) {
+            pageLock = PageLock(data, size);
+        }
+    }
+}
+
+template<typename MemorySpace>
+std::pair<MultiSetBySizeT::iterator, SetByIndexT::iterator> BasicMemoryPool<MemorySpace>::insertIntoSets(IndexPair indices) {
+    auto setBySizeItr = freeSetBySize.insert(indices);
+    auto [setByIndexItr, inserted] = freeSetByIndex.insert(indices);
+    
+    assert(inserted);
+    numFreeChunks += indices.second - indices.first;
+
+    return {setBySizeItr, setByIndexItr};
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::removeFromSets(IndexPair indices) {
+    freeSetBySize.erase(indices);
+
+    if (freeSetByIndex.erase(indices)) {
+        numFreeChunks -= indices.second - indices.first;
+    }
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMemoryPool<MemorySpace>::allocate(size_t n) {
+    size_t requestedChunks = getRequiredChunks(n);
+
+    auto indices = takeFromQuickList(requestedChunks);
+    if (!indices) {
+        indices = takeFreeChunks(requestedChunks);
+    }
+
+    return indices ? recordAllocation(*indices) : nullptr;
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMemoryPool<MemorySpace>::allocateZeroed(size_t n) {
+    size_t requestedChunks = getRequiredChunks(n);
+
+    auto indices = takeFromQuickList(requestedChunks);
+    if (indices) {
+        markDirty(*indices); // Quick listed blocks are only marked once merged into the free sets
+    } else {
+        indices = takeFreeChunks(requestedChunks);
+    }
+
+    if (!indices) {
+        return nullptr;
+    }
+
+    zeroDirtyChunks(*indices);
+    return recordAllocation(*indices);
+}
+
+template<typename MemorySpace>
+std::optional<IndexPair> BasicMemoryPool<MemorySpace>::findFreeRun(size_t minChunks) const {
+    auto fits = [minChunks](IndexPair freeRun) { return freeRun.second - freeRun.first >= minChunks; };
+
+    switch (placement) {
+        case PlacementPolicy::BestFit: {
+            auto freeSetItr = freeSetBySize.lower_bound(minChunks);
+            if (freeSetItr != freeSetBySize.end()) {
+                return *freeSetItr;
+            }
+
+            break;
+        }
+        case PlacementPolicy::FirstFit: {
+            auto freeSetItr = std::find_if(freeSetByIndex.begin(), freeSetByIndex.end(), fits);
+            if (freeSetItr != freeSetByIndex.end()) {
+                return *freeSetItr;
+            }
+
+            break;
+        }
+        case PlacementPolicy::NextFit: {
+            // A run containing nextFitIndex starts before it, so step back one run if that run reaches past it
+            auto rover = freeSetByIndex.upper_bound({nextFitIndex, std::numeric_limits<size_t>::max()});
+            if (rover != freeSetByIndex.begin() && std::prev(rover)->second > nextFitIndex) {
+                rover--;
+            }
+
+            auto freeSetItr = std::find_if(rover, freeSetByIndex.end(), fits);
+            if (freeSetItr != freeSetByIndex.end()) {
+                return *freeSetItr;
+            }
+
+            freeSetItr = std::find_if(freeSetByIndex.begin(), rover, fits);
+            if (freeSetItr != rover) {
+                return *freeSetItr;
+            }
+
+            break;
+        }
+        case PlacementPolicy::WorstFit: {
+            if (!freeSetBySize.empty() && fits(*freeSetBySize.rbegin())) {
+                return *freeSetBySize.rbegin();
+            }
+
+            break;
+        }
+    }
+
+    return {};
+}
+
+template<typename MemorySpace>
+std::optional<IndexPair> BasicMemoryPool<MemorySpace>::takeFreeChunks(size_t requestedChunks) {
+    if (cacheColors > 1 && requestedChunks * DEFAULT_CHUNK_SIZE >= coloringThreshold) {
+        if (auto indices = takeColoredChunks(requestedChunks)) {
+            return indices;
+        }
+    }
+
+    auto freeRun = findFreeRun(requestedChunks);
+    if (!freeRun && (numQuickListChunks || numDeferredChunks)) {
+        mergeHeldBlocks(); // Merged with their neighbours they may make room
+        freeRun = findFreeRun(requestedChunks);
+    }
+
+    if (!freeRun) {
+        return {};
+    }
+
+    IndexPair indices = {freeRun->first, freeRun->first + requestedChunks};
+    takeFromFreeRun(*freeRun, indices);
+    nextFitIndex = indices.second;
+
+    return indices;
+}
+
+template<typename MemorySpace>
+std::optional<IndexPair> BasicMemoryPool<MemorySpace>::takeColoredChunks(size_t requestedChunks) {
+    // Runs this long can be shifted onto any color. Smaller ones are left to the uncolored placement.
+    auto freeRun = findFreeRun(requestedChunks + cacheColors - 1);
+    if (!freeRun) {
+        return {};
+    }
+
+    size_t color = nextColor;
+    nextColor = (nextColor + 1) % cacheColors;
+
+    // Colors are absolute chunk offsets, so they stay apart across sub-pools too. The chunks skipped are taken along and
+    // handed back with the allocation in releaseAllocation.
+    size_t runColor = ((reinterpret_cast<uintptr_t>(pool.data()) / DEFAULT_CHUNK_SIZE) + freeRun->first) % cacheColors;
+    size_t shift = (color + cacheColors - runColor) % cacheColors;
+
+    IndexPair indices = {freeRun->first + shift, freeRun->first + shift + requestedChunks};
+    takeFromFreeRun(*freeRun, {freeRun->first, indices.second});
+    nextFitIndex = indices.second;
+
+    if (shift) {
+        colorPadding[indices.first] = shift;
+        numAllocatedChunks += shift;
+    }
+
+    return indices;
+}
+
+template<typename MemorySpace>
+std::optional<IndexPair> BasicMemoryPool<MemorySpace>::takeFromQuickList(size_t requestedChunks) {
+    if (requestedChunks == 0 || requestedChunks > quickLists.size() || quickLists[requestedChunks - 1].empty()) {
+        return {};
+    }
+
+    auto& quickList = quickLists[requestedChunks - 1];
+    size_t beginIndex = quickList.back();
+
+    quickList.pop_back();
+    numQuickListChunks -= requestedChunks;
+
+    return std::make_pair(beginIndex, beginIndex + requestedChunks);
+}
+
+template<typename MemorySpace>
+bool BasicMemoryPool<MemorySpace>::pushToQuickList(IndexPair indices) {
+    size_t numChunks = indices.second - indices.first;
+    if (quickListDepth == 0 || numChunks == 0 || numChunks > quickLists.size()) {
+        return false;
+    }
+
+    if (quickLists[numChunks - 1].size() == quickListDepth) {
+        flushQuickList(numChunks);
+    }
+
+    quickLists[numChunks - 1].push_back(indices.first);
+    numQuickListChunks += numChunks;
+
+    return true;
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::flushQuickList(size_t numChunks) {
+    auto& quickList = quickLists[numChunks - 1];
+
+    for (size_t beginIndex : quickList) {
+        markDirty({beginIndex, beginIndex + numChunks});
+        freeChunks({beginIndex, beginIndex + numChunks});
+    }
+
+    numQuickListChunks -= quickList.size() * numChunks;
+    quickList.clear();
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::flushQuickLists() {
+    for (size_t numChunks = 1; numQuickListChunks && numChunks <= quickLists.size(); numChunks++) {
+        flushQuickList(numChunks);
+    }
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::deferFree(IndexPair indices) {
+    deferredFrees.push_back(indices);
+    numDeferredChunks += indices.second - indices.first;
+
+    if (deferredFrees.size() == maxDeferredFrees) {
+        coalesceDeferredFrees();
+    }
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::coalesceDeferredFrees() {
+    std::sort(deferredFrees.begin(), deferredFrees.end());
+
+    for (IndexPair indices : deferredFrees) {
+        markDirty(indices);
+    }
+
+    // Both are sorted, so a single pass over the free runs finds every neighbour
+    auto freeSetItr = freeSetByIndex.begin();
+
+    for (size_t i = 0; i < deferredFrees.size();) {
+        auto [beginIndex, endIndex] = deferredFrees[i++];
+
+        while (freeSetItr != freeSetByIndex.end() && freeSetItr->second < beginIndex) {
+            freeSetItr++;
+        }
+
+        if (freeSetItr != freeSetByIndex.end() && freeSetItr->second == beginIndex) {
+            beginIndex = freeSetItr->first;
+            removeFromSets(*freeSetItr++);
+        }
+
+        // Deferred frees and free runs may alternate, each touching the next
+        for (bool merged = true; merged;) {
+            merged = false;
+
+            while (i < deferredFrees.size() && deferredFrees[i].first == endIndex) {
+                endIndex = deferredFrees[i++].second;
+                merged = true;
+            }
+
+            if (freeSetItr != freeSetByIndex.end() && freeSetItr->first == endIndex) {
+                endIndex = freeSetItr->second;
+                removeFromSets(*freeSetItr++);
+                merged = true;
+            }
+        }
+
+        insertIntoSets({beginIndex, endIndex});
+    }
+
+    deferredFrees.clear();
+    numDeferredChunks = 0;
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::mergeHeldBlocks() {
+    flushQuickLists();
+    coalesceDeferredFrees();
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMemoryPool<MemorySpace>::recordAllocation(IndexPair indices) {
+    uint8_t* ptr = pool.data() + (indices.first * DEFAULT_CHUNK_SIZE);
+
+    allocationEnds[indices.first] = indices.second;
+    numAllocations++;
+    numAllocatedChunks += indices.second - indices.first;
+
+    return ptr;
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::markDirty(IndexPair indices) {
+    auto [beginIndex, endIndex] = indices;
+
+    auto dirtyItr = dirtyChunks.upper_bound({beginIndex, std::numeric_limits<size_t>::max()});
+    if (dirtyItr != dirtyChunks.begin() && std::prev(dirtyItr)->second >= beginIndex) {
+        dirtyItr--;
+    }
+
+    // Absorb every range that overlaps or touches the new one
+    while (dirtyItr != dirtyChunks.end() && dirtyItr->first <= endIndex) {
+        beginIndex = std::min(beginIndex, dirtyItr->first);
+        endIndex = std::max(endIndex, dirtyItr->second);
+        dirtyItr = dirtyChunks.erase(dirtyItr);
+    }
+
+    dirtyChunks.insert(dirtyItr, {beginIndex, endIndex});
+}
+
+template<typename MemorySpace>
+std::vector<IndexPair> BasicMemoryPool<MemorySpace>::clearDirty(IndexPair indices) {
+    std::vector<IndexPair> cleared;
+
+    auto dirtyItr = dirtyChunks.upper_bound({indices.first, std::numeric_limits<size_t>::max()});
+    if (dirtyItr != dirtyChunks.begin() && std::prev(dirtyItr)->second > indices.first) {
+        dirtyItr--;
+    }
+
+    while (dirtyItr != dirtyChunks.end() && dirtyItr->first < indices.second) {
+        auto [beginIndex, endIndex] = *dirtyItr;
+        dirtyItr = dirtyChunks.erase(dirtyItr);
+
+        if (beginIndex < indices.first) {
+            dirtyChunks.insert(dirtyItr, {beginIndex, indices.first});
+        }
+
+        if (endIndex > indices.second) {
+            dirtyItr = dirtyChunks.insert(dirtyItr, {indices.second, endIndex});
+        }
+
+        cleared.emplace_back(std::max(beginIndex, indices.first), std::min(endIndex, indices.second));
+    }
+
+    return cleared;
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::zeroDirtyChunks(IndexPair indices) {
+    for (auto [beginIndex, endIndex] : clearDirty(indices)) {
+        // Fills in parallel on the execution space that owns the pool's memory
+        Kokkos::deep_copy(Kokkos::subview(pool, std::make_pair(beginIndex * DEFAULT_CHUNK_SIZE, endIndex * DEFAULT_CHUNK_SIZE)), uint8_t{0});
+    }
+}
+
+template<typename MemorySpace>
+size_t BasicMemoryPool<MemorySpace>::purgeFreeChunks() {
+    size_t purgedChunks = 0;
+
+    if (pageLock.isLocked()) {
+        return purgedChunks;
+    }
+
+    mergeHeldBlocks();
+
+#ifdef __linux__
+    // Discarded private anonymous pages read back as zero. Device memory has no equivalent, so it is left dirty.
+    if constexpr (std::is_same_v<MemorySpace, Kokkos::HostSpace>) {
+        auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        auto base = reinterpret_cast<uintptr_t>(pool.data());
+
+        for (auto [freeBegin, freeEnd] : freeSetByIndex) {
+            uintptr_t pageBegin = (base + (freeBegin * DEFAULT_CHUNK_SIZE) + pageSize - 1) / pageSize * pageSize;
+            uintptr_t pageEnd = (base + (freeEnd * DEFAULT_CHUNK_SIZE)) / pageSize * pageSize;
+
+            // Only chunks lying entirely inside the discarded pages become known zero
+            IndexPair purged = {(pageBegin - base + DEFAULT_CHUNK_SIZE - 1) / DEFAULT_CHUNK_SIZE, (pageEnd - base) / DEFAULT_CHUNK_SIZE};
+            if (pageBegin >= pageEnd || purged.first >= purged.second || clearDirty(purged).empty()) {
+                continue;
+            }
+
+            if (madvise(reinterpret_cast<void*>(pageBegin), pageEnd - pageBegin, MADV_DONTNEED) == 0) {
+                purgedChunks += purged.second - purged.first;
+            } else {
+                markDirty(purged);
+            }
+        }
+    }
+#endif
+
+    return purgedChunks;
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMemoryPool<MemorySpace>::allocateAt(IndexPair indices) {
+    mergeHeldBlocks();
+
+    auto freeSetItr = freeSetByIndex.upper_bound({indices.first, std::numeric_limits<size_t>::max()});
+    if (freeSetItr == freeSetByIndex.begin()) {
+        return nullptr;
+    }
+
+    IndexPair freeRun = *std::prev(freeSetItr);
+    if (indices.first < freeRun.first || indices.second > freeRun.second) {
+        return nullptr;
+    }
+
+    takeFromFreeRun(freeRun, indices);
+    return recordAllocation(indices);
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::deallocate(uint8_t *data) {
+    size_t beginIndex = getChunkIndex(data);
+    assert(allocationEnds[beginIndex]);
+
+    releaseAllocation({beginIndex, allocationEnds[beginIndex]});
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::deallocate(uint8_t *data, size_t n) {
+    size_t beginIndex = getChunkIndex(data);
+    size_t endIndex = beginIndex + getRequiredChunks(n);
+
+    assert(allocationEnds[beginIndex] == endIndex); // Sized with something other than what was allocated
+    releaseAllocation({beginIndex, endIndex});
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMemoryPool<MemorySpace>::splitAllocation(uint8_t *data, size_t n) {
+    size_t beginIndex = getChunkIndex(data);
+    size_t splitIndex = beginIndex + getRequiredChunks(n);
+    size_t endIndex = allocationEnds[beginIndex];
+
+    assert(endIndex && splitIndex <= endIndex);
+    if (splitIndex == endIndex) {
+        return nullptr;
+    }
+
+    allocationEnds[beginIndex] = splitIndex;
+    allocationEnds[splitIndex] = endIndex;
+    numAllocations++;
+
+    return pool.data() + (splitIndex * DEFAULT_CHUNK_SIZE);
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::releaseAllocation(IndexPair indices) {
+    allocationEnds[indices.first] = 0;
+    numAllocations--;
+    numAllocatedChunks -= indices.second - indices.first;
+
+    if (!colorPadding.empty()) {
+        if (auto paddingItr = colorPadding.find(indices.first); paddingItr != colorPadding.end()) {
+            indices.first -= paddingItr->second;
+            numAllocatedChunks -= paddingItr->second;
+            colorPadding.erase(paddingItr);
+        }
+    }
+
+    if (pushToQuickList(indices)) {
+        return;
+    }
+
+    if (maxDeferredFrees) {
+        deferFree(indices);
+    } else {
+        markDirty(indices); // Assume the caller wrote to everything it was given
+        freeChunks(indices);
+    }
+}
+
+template<typename MemorySpace>
+size_t BasicMemoryPool<MemorySpace>::getChunkIndex(const uint8_t *data) const {
+    assert(data >= pool.data() && data < pool.data() + pool.size());
+    assert((data - pool.data()) % DEFAULT_CHUNK_SIZE == 0);
+
+    return (data - pool.data()) / DEFAULT_CHUNK_SIZE;
+}
+
+template<typename MemorySpace>
+size_t BasicMemoryPool<MemorySpace>::getAllocationSize(uint8_t *data) const {
+    size_t beginIndex = getChunkIndex(data);
+    assert(allocationEnds[beginIndex]);
+
+    return allocationEnds[beginIndex] - beginIndex;
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::freeChunks(IndexPair chunkIndices) {
+    auto [freeSetBySizeItr, freeSetByIndexItr] = insertIntoSets(chunkIndices);
+
+    // Merge adjacent free chunks
+    if (freeSetByIndexItr != freeSetByIndex.begin()) {
+        auto prevItr = std::prev(freeSetByIndexItr);
+        auto [prevBeginIndex, prevEndIndex] = *prevItr;
+
+        if (prevEndIndex == chunkIndices.first) {
+            removeFromSets(*prevItr);
+            removeFromSets(chunkIndices);
+            freeSetByIndexItr = insertIntoSets({prevBeginIndex, chunkIndices.second}).second;
+        }
+    }
+
+    if (std::next(freeSetByIndexItr) != freeSetByIndex.end()) {
+        auto nextItr = std::next(freeSetByIndexItr);
+        auto [nextBeginIndex, nextEndIndex] = *nextItr;
+        auto [beginIndex, endIndex] = *freeSetByIndexItr;
+
+        if (chunkIndices.second == nextBeginIndex) {
+            removeFromSets(*freeSetByIndexItr);
+            removeFromSets(*nextItr);
+            insertIntoSets({beginIndex, nextEndIndex});
+        }
+    }
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::takeFromFreeRun(IndexPair freeRun, IndexPair taken) {
+    removeFromSets(freeRun);
+
+    if (freeRun.first != taken.first) {
+        insertIntoSets({freeRun.first, taken.first});
+    }
+
+    if (freeRun.second != taken.second) {
+        insertIntoSets({taken.second, freeRun.second});
+    }
+}
+
+template<typename MemorySpace>
+std::optional<IndexPair> BasicMemoryPool<MemorySpace>::takeDirtyFreeRun(size_t maxChunks) {
+    mergeHeldBlocks(); // Blocks freed since the last merge are always dirty
+
+    for (const auto& [dirtyBegin, dirtyEnd] : dirtyChunks) {
+        // The first free run overlapping this dirty range either contains its start or begins after it
+        auto freeSetItr = freeSetByIndex.upper_bound({dirtyBegin, std::numeric_limits<size_t>::max()});
+        if (freeSetItr != freeSetByIndex.begin() && std::prev(freeSetItr)->second > dirtyBegin) {
+            freeSetItr--;
+        }
+
+        if (freeSetItr == freeSetByIndex.end() || freeSetItr->first >= dirtyEnd) {
+            continue;
+        }
+
+        IndexPair freeRun = *freeSetItr;
+        size_t beginIndex = std::max(dirtyBegin, freeRun.first);
+        size_t endIndex = std::min({dirtyEnd, freeRun.second, beginIndex + maxChunks});
+
+        takeFromFreeRun(freeRun, {beginIndex, endIndex});
+        return std::make_pair(beginIndex, endIndex);
+    }
+
+    return {};
+}
+
+template<typename MemorySpace>
+void BasicMemoryPool<MemorySpace>::returnCleanRun(IndexPair indices) {
+    clearDirty(indices);
+    freeChunks(indices);
+}
+
+template<typename MemorySpace>
+std::ostream &operator<<(std::ostream &os, const BasicMemoryPool<MemorySpace> &pool) {
+    std::vector<bool> used(pool.getNumChunks(), false);
+
+    for (const auto& indices : pool.getAllocationIndices()) {
+        for (size_t i = indices.first; i < indices.second; i++) {
+            used[i] = true;
+        }
+    }
+
+    for (auto i : used) {
+        os << (i ? "X" : "-");
+    }
+
+    os << "\nFree Set:  ";
+
+    for (const auto [beginIndex, endIndex] : pool.freeSetBySize) {
+        os << "[" << beginIndex << ", " << endIndex << ") ";
+    }
+
+    os << "\n";
+
+    return os;
+}
+
+template<typename MemorySpace>
+unsigned BasicMemoryPool<MemorySpace>::getNumAllocations() const {
+    return numAllocations;
+}
+
+template<typename MemorySpace>
+unsigned BasicMemoryPool<MemorySpace>::getNumFreeChunks() const {
+    return numFreeChunks + numQuickListChunks + numDeferredChunks;
+}
+
+template<typename MemorySpace>
+unsigned BasicMemoryPool<MemorySpace>::getNumAllocatedChunks() const {
+    return numAllocatedChunks;
+}
+
+template<typename MemorySpace>
+unsigned BasicMemoryPool<MemorySpace>::getNumChunks() const {
+    return pool.size() / DEFAULT_CHUNK_SIZE;
+}
+
+template<typename MemorySpace>
+unsigned BasicMemoryPool<MemorySpace>::getNumFreeFragments() const {
+    size_t numFreeFragments = freeSetBySize.size() + deferredFrees.size();
+
+    for (const auto& quickList : quickLists) {
+        numFreeFragments += quickList.size();
+    }
+
+    return numFreeFragments;
+}
+
+template<typename MemorySpace>
+std::vector<IndexPair> BasicMemoryPool<MemorySpace>::getAllocationIndices() const {
+    std::vector<IndexPair> indices;
+    indices.reserve(numAllocations);
+
+    for (size_t beginIndex = 0; beginIndex < allocationEnds.size();) {
+        if (allocationEnds[beginIndex]) {
+            indices.emplace_back(beginIndex, allocationEnds[beginIndex]);
+            beginIndex = allocationEnds[beginIndex];
+        } else {
+            beginIndex++;
+        }
+    }
+
+    return indices;
+}
+
+template<typename MemorySpace>
+std::vector<IndexPair> BasicMemoryPool<MemorySpace>::getAllocatedRuns() const {
+    std::vector<IndexPair> runs;
+    size_t previousEndIndex = 0;
+
+    for (const auto& [beginIndex, endIndex] : freeSetByIndex) {
+        if (beginIndex != previousEndIndex) {
+            runs.emplace_back(previousEndIndex, beginIndex);
+        }
+
+        previousEndIndex = endIndex;
+    }
+
+    if (previousEndIndex != getNumChunks()) {
+        runs.emplace_back(previousEndIndex, getNumChunks());
+    }
+
+    return runs;
+}
+
+template<typename MemorySpace>
+unsigned BasicMemoryPool<MemorySpace>::getNumDirtyFreeChunks() const {
+    unsigned numDirtyFreeChunks = numQuickListChunks + numDeferredChunks; // Held blocks are marked once merged
+    auto dirtyItr = dirtyChunks.begin();
+
+    // Both sets are sorted and disjoint, so intersect them in one pass
+    for (const auto& [freeBegin, freeEnd] : freeSetByIndex) {
+        while (dirtyItr != dirtyChunks.end() && dirtyItr->second <= freeBegin) {
+            dirtyItr++;
+        }
+
+        for (auto itr = dirtyItr; itr != dirtyChunks.end() && itr->first < freeEnd; itr++) {
+            numDirtyFreeChunks += std::min(itr->second, freeEnd) - std::max(itr->first, freeBegin);
+        }
+    }
+
+    return numDirtyFreeChunks;
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMemoryPool<MemorySpace>::getBaseAddress() const {
+    return pool.data();
+}
+
+template<typename MemorySpace>
+size_t BasicMemoryPool<MemorySpace>::getSizeInBytes() const {
+    return pool.size();
+}
+
+template<typename MemorySpace>
+bool BasicMemoryPool<MemorySpace>::isLocked() const {
+    return pageLock.isLocked();
+}
+
+template<typename MemorySpace>
+std::chrono::nanoseconds BasicMemoryPool<MemorySpace>::getPrefaultTime() const {
+    return prefaultTime;
+}
+
+template<typename MemorySpace>
+size_t BasicMemoryPool<MemorySpace>::getRequiredChunks(size_t n) {
+    return std::max<size_t>((n / DEFAULT_CHUNK_SIZE) + (n % DEFAULT_CHUNK_SIZE ? 1 : 0), 1);
+}
+
+template<typename MemorySpace>
+Kokkos::View<uint8_t*, MemorySpace> BasicMemoryPool<MemorySpace>::allocateMemory(size_t numChunks) {
+    return Kokkos::View<uint8_t*, MemorySpace>(Kokkos::view_alloc(Kokkos::WithoutInitializing, "Memory Pool"), numChunks * DEFAULT_CHUNK_SIZE);
+}
+
+template<typename MemorySpace>
+std::chrono::nanoseconds BasicMultiPool<MemorySpace>::getPrefaultTime() const {
+    auto prefaultTime = std::chrono::nanoseconds::zero();
+
+    for (const auto& pool : pools) {
+        prefaultTime += pool.getPrefaultTime();
+    }
+
+    return prefaultTime;
+}
+
+template<typename MemorySpace>
+size_t BasicMultiPool<MemorySpace>::getChunkSize() const {
+    return PoolT::DEFAULT_CHUNK_SIZE;
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumFreeFragments() const {
+    unsigned numFreeFragments = 0;
+
+    for (const auto& pool : pools) {
+        numFreeFragments += pool.getNumFreeFragments();
+    }
+
+    return numFreeFragments;
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumDirtyFreeChunks() const {
+    unsigned numDirtyFreeChunks = 0;
+
+    for (const auto& pool : pools) {
+        numDirtyFreeChunks += pool.getNumDirtyFreeChunks();
+    }
+
+    return numDirtyFreeChunks;
+}
+
+template<typename MemorySpace>
+size_t BasicMultiPool<MemorySpace>::purgeFreeChunks() {
+    size_t purgedChunks = 0;
+
+    for (auto& pool : pools) {
+        purgedChunks += pool.purgeFreeChunks();
+    }
+
+    return purgedChunks;
+}
+
+template<typename MemorySpace>
+std::optional<typename BasicMultiPool<MemorySpace>::DirtyRun> BasicMultiPool<MemorySpace>::takeDirtyFreeRun(size_t maxChunks) {
+    for (auto& pool : pools) {
+        if (auto indices = pool.takeDirtyFreeRun(maxChunks)) {
+            return DirtyRun{&pool, *indices};
+        }
+    }
+
+    return {};
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::returnCleanRun(const DirtyRun &run) {
+    run.pool->returnCleanRun(run.indices);
+}
+
+template<typename MemorySpace>
+BasicMultiPool<MemorySpace>::BasicMultiPool(size_t initialChunks, PoolInitializer initializer) : poolInitializer(std::move(initializer)) {
+    addPool(initialChunks);
+}
+
+template<typename MemorySpace>
+BasicMultiPool<MemorySpace>::BasicMultiPool(size_t initialChunks, const PoolOptions &options, PoolInitializer initializer)
+        : poolInitializer(std::move(initializer)), poolOptions(options) {
+    addPool(initialChunks);
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::setPoolInitializer(PoolInitializer initializer) {
+    poolInitializer = std::move(initializer);
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::addPool(size_t numChunks) {
+    SubPoolMemory memory = allocateSubPoolMemory(numChunks, poolOptions.clearWithMemset);
+    pools.emplace_back(std::move(memory.memory), poolOptions, memory.zeroed);
+    registerPool(std::prev(pools.end()));
+}
+
+template<typename MemorySpace>
+typename BasicMultiPool<MemorySpace>::SubPoolMemory BasicMultiPool<MemorySpace>::allocateSubPoolMemory(size_t numChunks, bool clearOnHost) {
+    SubPoolMemory memory{PoolT::allocateMemory(numChunks), false};
+
+    if constexpr (std::is_same_v<MemorySpace, Kokkos::HostSpace>) {
+        if (clearOnHost) {
+            std::memset(memory.memory.data(), 0, memory.memory.size());
+            memory.zeroed = true;
+        }
+    }
+
+    return memory;
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::registerPool(typename PoolListT::iterator poolItr) {
+    poolsByAddress[poolItr->getBaseAddress()] = poolItr;
+
+    if (poolInitializer) {
+        poolInitializer(*poolItr);
+    }
+}
+
+// Searches the handful of sub-pools, which at least double in size each time, rather than every allocation
+template<typename MemorySpace>
+typename BasicMultiPool<MemorySpace>::PoolListT::iterator BasicMultiPool<MemorySpace>::findPool(const uint8_t *data) const {
+    auto poolItr = std::prev(poolsByAddress.upper_bound(data))->second;
+    assert(data < poolItr->getBaseAddress() + poolItr->getSizeInBytes());
+
+    return poolItr;
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::allocate(size_t n) {
+    return allocateFromPools(n, false);
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::allocateZeroed(size_t n) {
+    return allocateFromPools(n, true);
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::tryAllocate(size_t n) {
+    return allocateFromExistingPools(n, false);
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::tryAllocateZeroed(size_t n) {
+    return allocateFromExistingPools(n, true);
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::allocateFromExistingPools(size_t n, bool zeroed) {
+    adoptGrownPool(false);
+
+    for (auto current = pools.begin(); current != pools.end(); current++) {
+        if (uint8_t* ptr = allocateFromPool(current, n, zeroed)) {
+            return ptr;
+        }
+    }
+
+    return nullptr;
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::allocateFromPools(size_t n, bool zeroed) {
+    uint8_t* ptr = allocateFromExistingPools(n, zeroed);
+
+    // Nothing fits. Finishing a growth already in flight is cheaper than starting another one here.
+    if (!ptr && adoptGrownPool(true)) {
+        ptr = allocateFromPool(std::prev(pools.end()), n, zeroed);
+    }
+
+    if (!ptr) {
+        addPool((getLargestPoolSize() * 2) + PoolT::getRequiredChunks(n));
+        ptr = allocateFromPool(std::prev(pools.end()), n, zeroed);
+    }
+
+    growIfBelowLowWaterMark();
+
+    return ptr;
+}
+
+template<typename MemorySpace>
+uint8_t *BasicMultiPool<MemorySpace>::allocateFromPool(typename PoolListT::iterator poolItr, size_t n, bool zeroed) {
+    return zeroed ? poolItr->allocateZeroed(n) : poolItr->allocate(n);
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getLargestPoolSize() const {
+    unsigned mostAmountOfChunks = 0;
+
+    for (const auto& pool : pools) {
+        mostAmountOfChunks = std::max(mostAmountOfChunks, pool.getNumChunks());
+    }
+
+    return mostAmountOfChunks;
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::setLowWaterMark(double freeFraction) {
+    lowWaterMark = freeFraction;
+}
+
+template<typename MemorySpace>
+bool BasicMultiPool<MemorySpace>::isGrowing() const {
+    return grownPool.valid();
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::waitForGrowth() {
+    adoptGrownPool(true);
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::growIfBelowLowWaterMark() {
+    if (lowWaterMark <= 0 || grownPool.valid() || getNumFreeChunks() >= lowWaterMark * getNumChunks()) {
+        return;
+    }
+
+    bool prefaults = poolOptions.prefault || poolOptions.lock;
+
+    // No Kokkos kernel may be launched from this thread, so host memory is cleared with a plain memset. Prefaulting
+    // pools clear their pages on the adopting thread instead, which then also touches them first, as does device
+    // memory. Pools that never launch kernels gain nothing from leaving it to the adopting thread.
+    bool clearOnHost = !prefaults || poolOptions.clearWithMemset;
+
+    grownPool = std::async(std::launch::async, [numChunks = getLargestPoolSize() * 2, clearOnHost] {
+        return allocateSubPoolMemory(numChunks, clearOnHost);
+    });
+}
+
+template<typename MemorySpace>
+bool BasicMultiPool<MemorySpace>::adoptGrownPool(bool wait) {
+    if (!grownPool.valid()) {
+        return false;
+    }
+
+    if (!wait && grownPool.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+
+    SubPoolMemory grown = grownPool.get();
+    pools.emplace_back(std::move(grown.memory), poolOptions, grown.zeroed);
+    registerPool(std::prev(pools.end()));
+
+    return true;
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::deallocate(uint8_t *data) {
+    findPool(data)->deallocate(data);
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::deallocate(uint8_t *data, size_t n) {
+    findPool(data)->deallocate(data, n);
+}
+
+template<typename MemorySpace>
+template<typename ExecutionSpace>
+uint8_t *BasicMultiPool<MemorySpace>::allocate(size_t n, const ExecutionSpace &instance) {
+    static_assert(Kokkos::SpaceAccessibility<ExecutionSpace, MemorySpace>::accessible,
+            "Execution space must be able to access the memory space of the pool");
+
+    auto pendingItr = pendingDeallocations.find(instance.impl_instance_id());
+    if (pendingItr == pendingDeallocations.end()) {
+        return allocate(n);
+    }
+
+    // Smallest block this instance has released that still fits
+    auto& pending = pendingItr->second;
+    size_t requiredChunks = PoolT::getRequiredChunks(n);
+    auto bestFit = pending.end();
+
+    for (auto current = pending.begin(); current != pending.end(); current++) {
+        if (current->numChunks >= requiredChunks && (bestFit == pending.end() || current->numChunks < bestFit->numChunks)) {
+            bestFit = current;
+        }
+    }
+
+    if (bestFit == pending.end()) {
+        return allocate(n);
+    }
+
+    uint8_t* ptr = bestFit->data;
+    pending.erase(bestFit);
+
+    // The part not needed now may still be in use by the instance too, so it stays pending
+    if (uint8_t* rest = findPool(ptr)->splitAllocation(ptr, n)) {
+        pending.push_back({rest, getAllocationSize(rest)});
+    }
+
+    if (pending.empty()) {
+        pendingDeallocations.erase(pendingItr);
+    }
+
+    return ptr;
+}
+
+template<typename MemorySpace>
+template<typename SizesView, typename OffsetsView>
+uint8_t *BasicMultiPool<MemorySpace>::allocateBulk(const SizesView &sizes, const OffsetsView &offsets, size_t alignment) {
+    using ExecutionSpace = typename MemorySpace::execution_space;
+
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+    assert(offsets.extent(0) == sizes.extent(0) + 1);
+
+    size_t batchSize = 0;
+    size_t alignmentMask = alignment - 1;
+
+    Kokkos::parallel_scan("BasicMultiPool::allocateBulk", Kokkos::RangePolicy<ExecutionSpace>(0, sizes.extent(0)),
+            KOKKOS_LAMBDA(size_t i, size_t& offset, bool final) {
+        if (final) {
+            offsets(i) = offset;
+        }
+
+        offset += (sizes(i) + alignmentMask) & ~alignmentMask;
+    }, batchSize);
+
+    Kokkos::deep_copy(Kokkos::subview(offsets, std::make_pair(sizes.extent(0), sizes.extent(0) + 1)), batchSize);
+
+    return batchSize ? allocate(batchSize) : nullptr;
+}
+
+template<typename MemorySpace>
+template<typename ExecutionSpace>
+void BasicMultiPool<MemorySpace>::deallocateAsync(uint8_t *data, const ExecutionSpace &instance) {
+    static_assert(Kokkos::SpaceAccessibility<ExecutionSpace, MemorySpace>::accessible,
+            "Execution space must be able to access the memory space of the pool");
+
+    size_t numChunks = getAllocationSize(data);
+    pendingDeallocations[instance.impl_instance_id()].push_back({data, numChunks});
+}
+
+template<typename MemorySpace>
+template<typename ExecutionSpace>
+void BasicMultiPool<MemorySpace>::fence(const ExecutionSpace &instance) {
+    instance.fence("BasicMultiPool::fence");
+
+    auto pendingItr = pendingDeallocations.find(instance.impl_instance_id());
+    if (pendingItr == pendingDeallocations.end()) {
+        return;
+    }
+
+    for (auto [data, numChunks] : pendingItr->second) {
+        deallocate(data);
+    }
+
+    pendingDeallocations.erase(pendingItr);
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::fence() {
+    Kokkos::fence("BasicMultiPool::fence");
+
+    for (const auto& [instanceId, pending] : pendingDeallocations) {
+        for (auto [data, numChunks] : pending) {
+            deallocate(data);
+        }
+    }
+
+    pendingDeallocations.clear();
+}
+
+template<typename MemorySpace>
+size_t BasicMultiPool<MemorySpace>::getAllocationSize(uint8_t *data) const {
+    return findPool(data)->getAllocationSize(data);
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumPendingDeallocations() const {
+    unsigned numPending = 0;
+
+    for (const auto& [instanceId, pending] : pendingDeallocations) {
+        numPending += pending.size();
+    }
+
+    return numPending;
+}
+
+template<typename MemorySpace>
+void BasicMultiPool<MemorySpace>::snapshot(const std::string &path, unsigned numThreads) {
+    static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace, MemorySpace>::accessible, "Snapshots require host accessible pools");
+
+    fence();
+
+    std::vector<PoolSnapshotInfo> infos;
+    std::vector<uint8_t*> baseAddresses;
+
+    for (const auto& pool : pools) {
+        infos.push_back({pool.getNumChunks(), reinterpret_cast<uintptr_t>(pool.getBaseAddress()), pool.getAllocationIndices(), pool.getAllocatedRuns()});
+        baseAddresses.push_back(pool.getBaseAddress());
+    }
+
+    writePoolSnapshot(path, PoolT::DEFAULT_CHUNK_SIZE, infos, baseAddresses, numThreads);
+}
+
+template<typename MemorySpace>
+std::map<uint8_t*, uint8_t*> BasicMultiPool<MemorySpace>::restore(const std::string &path, unsigned numThreads) {
+    static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace, MemorySpace>::accessible, "Snapshots require host accessible pools");
+
+    std::vector<PoolSnapshotInfo> infos = readPoolSnapshotInfo(path, PoolT::DEFAULT_CHUNK_SIZE);
+    std::vector<uint8_t*> baseAddresses;
+    std::map<uint8_t*, uint8_t*> restoredAddresses;
+
+    // Rebuilt off to the side, so a snapshot that fails to load leaves the current sub-pools untouched
+    PoolListT restoredPools;
+
+    for (const auto& info : infos) {
+        SubPoolMemory memory = allocateSubPoolMemory(info.numChunks, poolOptions.clearWithMemset);
+        PoolT& pool = restoredPools.emplace_back(std::move(memory.memory), poolOptions, memory.zeroed);
+        baseAddresses.push_back(pool.getBaseAddress());
+
+        if (poolInitializer) {
+            poolInitializer(pool);
+        }
+
+        for (auto indices : info.allocations) {
+            uint8_t* ptr = pool.allocateAt(indices);
+            if (!ptr) {
+                throw std::runtime_error(path + " has allocations that do not fit its pools");
+            }
+
+            restoredAddresses[reinterpret_cast<uint8_t*>(info.baseAddress + (indices.first * PoolT::DEFAULT_CHUNK_SIZE))] = ptr;
+        }
+    }
+
+    readPoolSnapshotData(path, PoolT::DEFAULT_CHUNK_SIZE, infos, baseAddresses, numThreads);
+
+    // A sub-pool still growing in the background was sized for the pools being replaced, so it is dropped
+    if (grownPool.valid()) {
+        grownPool.wait();
+        grownPool = {};
+    }
+
+    pools.swap(restoredPools);
+    poolsByAddress.clear();
+    pendingDeallocations.clear();
+
+    for (auto poolItr = pools.begin(); poolItr != pools.end(); poolItr++) {
+        poolsByAddress[poolItr->getBaseAddress()] = poolItr;
+    }
+
+    return restoredAddresses;
+}
+
+template<typename MemorySpace>
+std::ostream &operator<<(std::ostream &os, const BasicMultiPool<MemorySpace> &multiPool) {
+    for (const auto& pool : multiPool.pools) {
+        os << pool << ' ';
+    }
+
+    return os;
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumAllocations() const {
+    unsigned numAllocations = 0;
+
+    for (const auto& pool : pools) {
+        numAllocations += pool.getNumAllocations();
+    }
+
+    return numAllocations;
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumFreeChunks() const {
+    unsigned numFreeChunks = 0;
+
+    for (const auto& pool : pools) {
+        numFreeChunks += pool.getNumFreeChunks();
+    }
+
+    return numFreeChunks;
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumAllocatedChunks() const {
+    unsigned numAllocatedChunks = 0;
+
+    for (const auto& pool : pools) {
+        numAllocatedChunks += pool.getNumAllocatedChunks();
+    }
+
+    return numAllocatedChunks;
+}
+
+template<typename MemorySpace>
+unsigned BasicMultiPool<MemorySpace>::getNumChunks() const {
+    unsigned numChunks = 0;
+
+    for (const auto& pool : pools) {
+        numChunks += pool.getNumChunks();
+    }
+
+    return numChunks;
+}
+
 #endif //KOKKOS_MEMORY_POOL_MEMORYPOOL_HPP
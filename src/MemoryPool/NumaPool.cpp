@@ -0,0 +1,250 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "NumaPool.hpp"
+
+namespace {
+// Parses the kernel's list format, like "0-3,8-11", into the ascending numbers it covers
+std::vector<unsigned> parseRangeList(const std::string& list) {
+    std::vector<unsigned> numbers;
+    std::istringstream ranges(list);
+
+    for (std::string range; std::getline(ranges, range, ',');) {
+        unsigned first = 0;
+        unsigned last = 0;
+        char dash = 0;
+        std::istringstream rangeStream(range);
+
+        if (!(rangeStream >> first)) {
+            continue;
+        }
+
+        last = (rangeStream >> dash >> last) ? last : first;
+
+        for (unsigned number = first; number <= last; number++) {
+            numbers.push_back(number);
+        }
+    }
+
+    return numbers;
+}
+}
+
+std::vector<unsigned> getNumaNodeIds() {
+#ifdef __linux__
+    // Node ids can have holes, for instance after hot-unplugging or on some multi-socket machines
+    std::ifstream onlineFile("/sys/devices/system/node/online");
+    std::string online;
+
+    if (std::getline(onlineFile, online)) {
+        if (auto nodeIds = parseRangeList(online); !nodeIds.empty()) {
+            return nodeIds;
+        }
+    }
+#endif
+    return {0};
+}
+
+unsigned getNumNumaNodes() {
+    return getNumaNodeIds().size();
+}
+
+unsigned getCurrentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0;
+    unsigned node = 0;
+
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+        return node;
+    }
+#endif
+    return 0;
+}
+
+bool bindToNumaNode(uint8_t *data, size_t bytes, unsigned node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr size_t BITS_PER_MASK_WORD = sizeof(unsigned long) * 8;
+
+    // Only the pages lying wholly inside the range are bound, the ones at its edges may hold unrelated heap memory
+    auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + pageSize - 1) / pageSize * pageSize;
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) / pageSize * pageSize;
+
+    if (end <= begin) {
+        return true;
+    }
+
+    std::vector<unsigned long> nodeMask((node / BITS_PER_MASK_WORD) + 1, 0);
+    nodeMask[node / BITS_PER_MASK_WORD] = 1UL << (node % BITS_PER_MASK_WORD);
+
+    // MPOL_MF_MOVE migrates the pages already touched when the backing view was zero filled
+    long result = syscall(SYS_mbind, begin, end - begin, MPOL_BIND, nodeMask.data(), nodeMask.size() * BITS_PER_MASK_WORD + 1, MPOL_MF_MOVE);
+    return result == 0;
+#else
+    return false;
+#endif
+}
+
+NumaNodeBinding::NumaNodeBinding(unsigned node) {
+#ifdef __linux__
+    std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string cpuList;
+
+    if (!std::getline(cpuListFile, cpuList)) {
+        return;
+    }
+
+    cpu_set_t previous;
+    if (sched_getaffinity(0, sizeof(previous), &previous) != 0) {
+        return;
+    }
+
+    cpu_set_t nodeCpus;
+    CPU_ZERO(&nodeCpus);
+
+    for (unsigned cpu : parseRangeList(cpuList)) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &nodeCpus);
+        }
+    }
+
+    if (CPU_COUNT(&nodeCpus) == 0 || sched_setaffinity(0, sizeof(nodeCpus), &nodeCpus) != 0) {
+        return;
+    }
+
+    previousAffinity.resize(sizeof(previous));
+    std::memcpy(previousAffinity.data(), &previous, sizeof(previous));
+    bound = true;
+#else
+    (void) node;
+#endif
+}
+
+NumaNodeBinding::~NumaNodeBinding() {
+#ifdef __linux__
+    if (bound) {
+        cpu_set_t previous;
+        std::memcpy(&previous, previousAffinity.data(), sizeof(previous));
+        sched_setaffinity(0, sizeof(previous), &previous);
+    }
+#endif
+}
+
+NumaMultiPool::NodePool::NodePool(size_t initialChunks, HostMultiPool::PoolInitializer initializer) : pool(initialChunks, std::move(initializer)) {}
+
+NumaMultiPool::NumaMultiPool(size_t initialChunksPerNode) : nodeIds(getNumaNodeIds()) {
+    for (unsigned node : nodeIds) {
+        nodes[node] = std::make_unique<NodePool>(initialChunksPerNode, [this, node](HostMemoryPool& pool) {
+            registerPool(pool, node);
+        });
+    }
+}
+
+void NumaMultiPool::registerPool(HostMemoryPool &pool, unsigned node) {
+    bool poolBound = nodeIds.size() == 1 || bindToNumaNode(pool.getBaseAddress(), pool.getSizeInBytes(), node);
+
+    std::unique_lock lock(rangesMutex);
+    ranges[pool.getBaseAddress()] = {pool.getBaseAddress() + pool.getSizeInBytes(), node};
+    bound = bound && poolBound;
+}
+
+uint8_t *NumaMultiPool::allocate(size_t n) {
+    return allocate(n, getCurrentNumaNode());
+}
+
+uint8_t *NumaMultiPool::allocate(size_t n, unsigned node) {
+    auto& nodePool = getNodePool(node);
+
+    std::lock_guard lock(nodePool.mutex);
+    return nodePool.pool.allocate(n);
+}
+
+void NumaMultiPool::deallocate(uint8_t *data) {
+    auto& nodePool = *nodes.at(getNodeOf(data));
+
+    std::lock_guard lock(nodePool.mutex);
+    nodePool.pool.deallocate(data);
+}
+
+unsigned NumaMultiPool::getNodeOf(const uint8_t *data) const {
+    std::shared_lock lock(rangesMutex);
+
+    auto rangeItr = ranges.upper_bound(data);
+    assert(rangeItr != ranges.begin());
+    rangeItr--;
+
+    auto [end, node] = rangeItr->second;
+    assert(data < end);
+
+    return node;
+}
+
+// Nodes that are not online, like the 0 getCurrentNumaNode falls back to, are served by the first online node
+NumaMultiPool::NodePool &NumaMultiPool::getNodePool(unsigned node) const {
+    auto nodeItr = nodes.find(node);
+    return *(nodeItr != nodes.end() ? nodeItr : nodes.begin())->second;
+}
+
+unsigned NumaMultiPool::getNumNodes() const {
+    return nodeIds.size();
+}
+
+const std::vector<unsigned> &NumaMultiPool::getNodeIds() const {
+    return nodeIds;
+}
+
+bool NumaMultiPool::isBound() const {
+    std::shared_lock lock(rangesMutex);
+    return bound;
+}
+
+template<typename Func>
+unsigned NumaMultiPool::sumOverNodes(Func func) const {
+    unsigned sum = 0;
+
+    for (const auto& [node, nodePool] : nodes) {
+        std::lock_guard lock(nodePool->mutex);
+        sum += func(nodePool->pool);
+    }
+
+    return sum;
+}
+
+unsigned NumaMultiPool::getNumAllocations() const {
+    return sumOverNodes([](const HostMultiPool& pool) { return pool.getNumAllocations(); });
+}
+
+unsigned NumaMultiPool::getNumFreeChunks() const {
+    return sumOverNodes([](const HostMultiPool& pool) { return pool.getNumFreeChunks(); });
+}
+
+unsigned NumaMultiPool::getNumAllocatedChunks() const {
+    return sumOverNodes([](const HostMultiPool& pool) { return pool.getNumAllocatedChunks(); });
+}
+
+unsigned NumaMultiPool::getNumChunks() const {
+    return sumOverNodes([](const HostMultiPool& pool) { return pool.getNumChunks(); });
+}
+
+unsigned NumaMultiPool::getNumFreeFragments() const {
+    return sumOverNodes([](const HostMultiPool& pool) { return pool.getNumFreeFragments(); });
+}
+
+std::ostream &operator<<(std::ostream &os, const NumaMultiPool &pool) {
+    for (const auto& [node, nodePool] : pool.nodes) {
+        std::lock_guard lock(nodePool->mutex);
+        os << "Node " << node << ": " << nodePool->pool << '\n';
+    }
+
+    return os;
+}
@@ -0,0 +1,99 @@
+#ifndef KOKKOS_MEMORY_POOL_NUMAPOOL_HPP
+#define KOKKOS_MEMORY_POOL_NUMAPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+
+std::vector<unsigned> getNumaNodeIds(); // Online node ids, ascending and not necessarily contiguous
+unsigned getNumNumaNodes();
+unsigned getCurrentNumaNode();
+bool bindToNumaNode(uint8_t* data, size_t bytes, unsigned node); // Returns false if the pages could not be bound
+
+// Pins the calling thread to the CPUs of a NUMA node for as long as it lives, then restores the previous affinity.
+// Threads Kokkos already started are not affected.
+class NumaNodeBinding {
+public:
+    explicit NumaNodeBinding(unsigned node);
+    ~NumaNodeBinding();
+
+    NumaNodeBinding(const NumaNodeBinding&) = delete;
+    NumaNodeBinding& operator=(const NumaNodeBinding&) = delete;
+
+    bool isBound() const { return bound; }
+
+private:
+    std::vector<unsigned char> previousAffinity; // The raw cpu_set_t, so sched.h stays out of this header
+    bool bound = false;
+};
+
+// Keeps one HostMultiPool per NUMA node and serves each thread from the pools of the node it is running on.
+// Backing pages are bound to their node with mbind. On single node machines or kernels without NUMA support this
+// degrades to a single, mutex guarded HostMultiPool. Nodes are addressed by their kernel ids, see getNodeIds.
+class NumaMultiPool {
+public:
+    explicit NumaMultiPool(size_t initialChunksPerNode);
+
+    uint8_t* allocate(size_t n);
+    uint8_t* allocate(size_t n, unsigned node);
+    void deallocate(uint8_t* data);
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n) {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType))), n);
+    }
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n, unsigned node) {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType), node)), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const NumaMultiPool &pool);
+
+    unsigned getNumNodes() const;
+    const std::vector<unsigned>& getNodeIds() const;
+    unsigned getNodeOf(const uint8_t* data) const;
+    bool isBound() const; // Whether every sub-pool was successfully bound to its node
+
+    unsigned getNumAllocations() const;
+    unsigned getNumFreeChunks() const;
+    unsigned getNumAllocatedChunks() const;
+    unsigned getNumChunks() const;
+    unsigned getNumFreeFragments() const;
+
+private:
+    struct NodePool {
+        NodePool(size_t initialChunks, HostMultiPool::PoolInitializer initializer);
+
+        mutable std::mutex mutex;
+        HostMultiPool pool;
+    };
+
+    void registerPool(HostMemoryPool& pool, unsigned node);
+    NodePool& getNodePool(unsigned node) const;
+
+    template<typename Func>
+    unsigned sumOverNodes(Func func) const;
+
+    std::vector<unsigned> nodeIds;
+    std::map<unsigned, std::unique_ptr<NodePool>> nodes; // By node id
+
+    mutable std::shared_mutex rangesMutex;
+    std::map<const uint8_t*, std::pair<const uint8_t*, unsigned>> ranges; // Start of sub-pool -> end and node
+    bool bound = true;
+};
+
+#endif //KOKKOS_MEMORY_POOL_NUMAPOOL_HPP
@@ -0,0 +1,109 @@
+#ifndef KOKKOS_MEMORY_POOL_OBJECTPOOL_HPP
+#define KOKKOS_MEMORY_POOL_OBJECTPOOL_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+
+// Fixed size object allocator on top of a MultiPool. Blocks taken from the MultiPool are carved into slots of
+// sizeof(T), and free slots are chained through their own storage, so there is no per-object bookkeeping. Objects
+// still alive when the ObjectPool is destroyed are not destructed; their blocks are returned to the MultiPool.
+template<typename T, typename MemorySpace = Kokkos::HostSpace>
+class ObjectPool {
+public:
+    static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace, MemorySpace>::accessible, "Objects are constructed on the host");
+    static_assert(alignof(T) <= BasicMemoryPool<MemorySpace>::CHUNK_ALIGNMENT, "Blocks are only aligned to chunks");
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    // Throws std::invalid_argument if objectsPerBlock is zero
+    explicit ObjectPool(BasicMultiPool<MemorySpace>& pool, size_t objectsPerBlock = std::max<size_t>(DEFAULT_BLOCK_SIZE / SLOT_SIZE, 1))
+            : pool(pool), objectsPerBlock(objectsPerBlock) {
+        if (objectsPerBlock == 0) {
+            throw std::invalid_argument("ObjectPool needs at least one object per block");
+        }
+    }
+
+    ~ObjectPool() {
+        for (uint8_t* block : blocks) {
+            pool.deallocate(block);
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template<typename... Args>
+    T* construct(Args&&... args) {
+        if (!freeList) {
+            addBlock();
+        }
+
+        FreeSlot* slot = freeList;
+        freeList = slot->next;
+        numObjects++;
+
+        return new (slot) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object) {
+        object->~T();
+
+        auto* slot = reinterpret_cast<FreeSlot*>(object);
+        slot->next = freeList;
+        freeList = slot;
+        numObjects--;
+    }
+
+    unsigned getNumObjects() const {
+        return numObjects;
+    }
+
+    unsigned getNumFreeSlots() const {
+        return (blocks.size() * objectsPerBlock) - numObjects;
+    }
+
+    unsigned getNumBlocks() const {
+        return blocks.size();
+    }
+
+    static constexpr size_t getSlotSize() {
+        return SLOT_SIZE;
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    static constexpr size_t SLOT_ALIGNMENT = std::max(alignof(T), alignof(FreeSlot));
+    static constexpr size_t SLOT_SIZE = (std::max(sizeof(T), sizeof(FreeSlot)) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+    void addBlock() {
+        uint8_t* block = pool.allocate(objectsPerBlock * SLOT_SIZE);
+        assert(reinterpret_cast<uintptr_t>(block) % SLOT_ALIGNMENT == 0);
+        blocks.push_back(block);
+
+        // Thread the slots back to front so construct hands them out in address order
+        for (size_t i = objectsPerBlock; i > 0; i--) {
+            auto* slot = reinterpret_cast<FreeSlot*>(block + ((i - 1) * SLOT_SIZE));
+            slot->next = freeList;
+            freeList = slot;
+        }
+    }
+
+    BasicMultiPool<MemorySpace>& pool;
+    size_t objectsPerBlock;
+    std::vector<uint8_t*> blocks;
+    FreeSlot* freeList = nullptr;
+    unsigned numObjects = 0;
+};
+
+#endif //KOKKOS_MEMORY_POOL_OBJECTPOOL_HPP
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <pthread.h>
+
+#include "OffsetPool.hpp"
+
+namespace {
+constexpr uint64_t SEGMENT_MAGIC = 0x4b4b4d504f4f4c31; // "KKMPOOL1"
+constexpr size_t BITS_PER_WORD = 64;
+constexpr size_t DATA_ALIGNMENT = 4096;
+
+size_t roundUp(size_t n, size_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+size_t getBitmapWords(size_t numChunks) {
+    return (numChunks + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+}
+
+struct OffsetPool::Header {
+    std::atomic<uint64_t> magic; // Written last so attaching processes never see a half formatted segment
+    uint64_t numChunks;
+    uint64_t dataOffset;
+    uint64_t numAllocations;
+    uint64_t numFreeChunks;
+    uint64_t roots[NUM_ROOTS];
+    pthread_mutex_t mutex;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Segment header requires address free atomics");
+
+class OffsetPool::LockGuard {
+public:
+    explicit LockGuard(const OffsetPool& pool) : mutex(pool.header->mutex) {
+        int result = pthread_mutex_lock(&mutex);
+
+        if (result == EOWNERDEAD) {
+            // A process died while holding the lock, possibly halfway through updating the bitmap or the counters
+            pool.rebuildFreeBitmap();
+            pthread_mutex_consistent(&mutex);
+        } else if (result != 0) {
+            // ENOTRECOVERABLE once an owner was unlocked without being made consistent. Only resetLock recovers it.
+            throw std::system_error(result, std::generic_category(), "pthread_mutex_lock");
+        }
+    }
+
+    ~LockGuard() {
+        pthread_mutex_unlock(&mutex);
+    }
+
+    LockGuard(const LockGuard&) = delete;
+    LockGuard& operator=(const LockGuard&) = delete;
+
+private:
+    pthread_mutex_t& mutex;
+};
+
+size_t OffsetPool::getRequiredBytes(size_t numChunks) {
+    size_t metadataBytes = roundUp(sizeof(Header), BITS_PER_WORD) + (numChunks * sizeof(uint64_t)) + (getBitmapWords(numChunks) * sizeof(uint64_t));
+    return roundUp(metadataBytes, DATA_ALIGNMENT) + (numChunks * CHUNK_SIZE);
+}
+
+OffsetPool::OffsetPool(uint8_t *segment) : header(reinterpret_cast<Header*>(segment)) {
+    size_t numChunks = header->numChunks;
+
+    allocationEnds = reinterpret_cast<uint64_t*>(segment + roundUp(sizeof(Header), BITS_PER_WORD));
+    freeBitmap = allocationEnds + numChunks;
+    data = segment + header->dataOffset;
+}
+
+OffsetPool OffsetPool::format(uint8_t *segment, size_t numChunks) {
+    auto* header = new (segment) Header{};
+    header->numChunks = numChunks;
+    header->dataOffset = getRequiredBytes(numChunks) - (numChunks * CHUNK_SIZE);
+    header->numAllocations = 0;
+    header->numFreeChunks = numChunks;
+    std::fill(header->roots, header->roots + NUM_ROOTS, INVALID_OFFSET);
+
+    OffsetPool pool(segment);
+    std::fill(pool.allocationEnds, pool.allocationEnds + numChunks, 0);
+    std::fill(pool.freeBitmap, pool.freeBitmap + getBitmapWords(numChunks), 0);
+    pool.setFree({0, numChunks}, true);
+    pool.resetLock();
+
+    header->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+    return pool;
+}
+
+OffsetPool OffsetPool::attach(uint8_t *segment, size_t segmentSize) {
+    if (!isFormatted(segment, segmentSize)) {
+        throw std::runtime_error("Segment does not contain an OffsetPool");
+    }
+
+    if (segmentSize < getRequiredBytes(reinterpret_cast<const Header*>(segment)->numChunks)) {
+        throw std::runtime_error("Segment is too small for the OffsetPool it contains");
+    }
+
+    return OffsetPool(segment);
+}
+
+bool OffsetPool::isFormatted(const uint8_t *segment, size_t segmentSize) {
+    return segmentSize >= sizeof(Header) && reinterpret_cast<const Header*>(segment)->magic.load(std::memory_order_acquire) == SEGMENT_MAGIC;
+}
+
+void OffsetPool::setRoot(size_t index, size_t offset) {
+    assert(index < NUM_ROOTS);
+
+    LockGuard lock(*this);
+    header->roots[index] = offset;
+}
+
+size_t OffsetPool::getRoot(size_t index) const {
+    assert(index < NUM_ROOTS);
+
+    LockGuard lock(*this);
+    return header->roots[index];
+}
+
+void OffsetPool::resetLock() {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+
+    int result = pthread_mutex_init(&header->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    if (result != 0) {
+        throw std::system_error(result, std::generic_category(), "pthread_mutex_init");
+    }
+}
+
+bool OffsetPool::isFree(size_t index) const {
+    return (freeBitmap[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1;
+}
+
+void OffsetPool::setFree(IndexPair indices, bool free) {
+    for (size_t i = indices.first; i < indices.second; i++) {
+        uint64_t bit = uint64_t{1} << (i % BITS_PER_WORD);
+
+        if (free) {
+            freeBitmap[i / BITS_PER_WORD] |= bit;
+        } else {
+            freeBitmap[i / BITS_PER_WORD] &= ~bit;
+        }
+    }
+}
+
+// The allocation table is the source of truth. Allocating clears the bits before recording the allocation and
+// deallocating forgets the allocation before setting them, so a dead owner's half done run is simply freed again. An
+// allocation that was recorded but never handed out stays allocated.
+void OffsetPool::rebuildFreeBitmap() const {
+    size_t numChunks = header->numChunks;
+
+    std::fill(freeBitmap, freeBitmap + getBitmapWords(numChunks), 0);
+    header->numAllocations = 0;
+    header->numFreeChunks = 0;
+
+    for (size_t i = 0; i < numChunks;) {
+        if (allocationEnds[i] > i && allocationEnds[i] <= numChunks) {
+            header->numAllocations++;
+            i = allocationEnds[i];
+        } else {
+            allocationEnds[i] = 0;
+            freeBitmap[i / BITS_PER_WORD] |= uint64_t{1} << (i % BITS_PER_WORD);
+            header->numFreeChunks++;
+            i++;
+        }
+    }
+}
+
+size_t OffsetPool::findFreeRun(size_t numChunks) const {
+    size_t runBegin = 0;
+    size_t runLength = 0;
+    size_t i = 0;
+
+    // First fit, skipping whole words that are entirely used
+    while (i < header->numChunks) {
+        if ((i % BITS_PER_WORD == 0) && (freeBitmap[i / BITS_PER_WORD] == 0)) {
+            runLength = 0;
+            i += BITS_PER_WORD;
+            continue;
+        }
+
+        if (isFree(i)) {
+            if (runLength++ == 0) {
+                runBegin = i;
+            }
+
+            if (runLength == numChunks) {
+                return runBegin;
+            }
+        } else {
+            runLength = 0;
+        }
+
+        i++;
+    }
+
+    return INVALID_OFFSET;
+}
+
+size_t OffsetPool::allocate(size_t n) {
+    size_t requestedChunks = HostMemoryPool::getRequiredChunks(n);
+
+    LockGuard lock(*this);
+
+    size_t beginIndex = findFreeRun(requestedChunks);
+    if (beginIndex == INVALID_OFFSET) {
+        return INVALID_OFFSET;
+    }
+
+    setFree({beginIndex, beginIndex + requestedChunks}, false);
+    allocationEnds[beginIndex] = beginIndex + requestedChunks;
+    header->numAllocations++;
+    header->numFreeChunks -= requestedChunks;
+
+    return beginIndex * CHUNK_SIZE;
+}
+
+void OffsetPool::deallocate(size_t offset) {
+    assert(offset % CHUNK_SIZE == 0);
+    size_t beginIndex = offset / CHUNK_SIZE;
+
+    LockGuard lock(*this);
+
+    size_t endIndex = allocationEnds[beginIndex];
+    assert(endIndex > beginIndex);
+
+    allocationEnds[beginIndex] = 0;
+    setFree({beginIndex, endIndex}, true);
+    header->numAllocations--;
+    header->numFreeChunks += endIndex - beginIndex;
+}
+
+uint8_t *OffsetPool::getAddress(size_t offset) const {
+    return data + offset;
+}
+
+size_t OffsetPool::getOffset(const uint8_t *ptr) const {
+    return ptr - data;
+}
+
+std::ostream &operator<<(std::ostream &os, const OffsetPool &pool) {
+    OffsetPool::LockGuard lock(pool);
+
+    for (size_t i = 0; i < pool.header->numChunks; i++) {
+        os << (pool.isFree(i) ? "-" : "X");
+    }
+
+    os << "\n";
+
+    return os;
+}
+
+unsigned OffsetPool::getNumAllocations() const {
+    LockGuard lock(*this);
+    return header->numAllocations;
+}
+
+unsigned OffsetPool::getNumFreeChunks() const {
+    LockGuard lock(*this);
+    return header->numFreeChunks;
+}
+
+unsigned OffsetPool::getNumAllocatedChunks() const {
+    LockGuard lock(*this);
+    return header->numChunks - header->numFreeChunks;
+}
+
+unsigned OffsetPool::getNumChunks() const {
+    return header->numChunks;
+}
+
+unsigned OffsetPool::getNumFreeFragments() const {
+    LockGuard lock(*this);
+    unsigned numFreeFragments = 0;
+
+    for (size_t i = 0; i < header->numChunks; i++) {
+        if (isFree(i) && (i == 0 || !isFree(i - 1))) {
+            numFreeFragments++;
+        }
+    }
+
+    return numFreeFragments;
+}
@@ -0,0 +1,63 @@
+#ifndef KOKKOS_MEMORY_POOL_OFFSETPOOL_HPP
+#define KOKKOS_MEMORY_POOL_OFFSETPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+#include "MemoryPool.hpp"
+
+// Chunk allocator whose free bitmap, allocation table and data all live inside one caller provided segment, so the
+// segment can be mapped by several processes or written to disk. Allocations are offsets from the start of the data
+// region rather than pointers. All operations are guarded by a process shared mutex stored in the segment.
+class OffsetPool {
+public:
+    static constexpr size_t INVALID_OFFSET = std::numeric_limits<size_t>::max();
+    static constexpr size_t CHUNK_SIZE = HostMemoryPool::DEFAULT_CHUNK_SIZE;
+    static constexpr size_t NUM_ROOTS = 16;
+
+    static size_t getRequiredBytes(size_t numChunks);
+    static OffsetPool format(uint8_t* segment, size_t numChunks);
+    // Throws if the segment was never formatted or is too small to hold the chunks its header records
+    static OffsetPool attach(uint8_t* segment, size_t segmentSize);
+    static bool isFormatted(const uint8_t* segment, size_t segmentSize);
+
+    size_t allocate(size_t n);
+    void deallocate(size_t offset);
+
+    uint8_t* getAddress(size_t offset) const;
+    size_t getOffset(const uint8_t* ptr) const;
+
+    // Root slots are kept in the header so a reopened segment can find its top level allocations again
+    void setRoot(size_t index, size_t offset);
+    size_t getRoot(size_t index) const;
+
+    void resetLock(); // Reinitializes the mutex, for segments whose previous users may have died holding it
+
+    friend std::ostream &operator<<(std::ostream &os, const OffsetPool &pool);
+
+    unsigned getNumAllocations() const;
+    unsigned getNumFreeChunks() const;
+    unsigned getNumAllocatedChunks() const;
+    unsigned getNumChunks() const;
+    unsigned getNumFreeFragments() const;
+
+private:
+    struct Header;
+    class LockGuard;
+
+    explicit OffsetPool(uint8_t* segment);
+
+    bool isFree(size_t index) const;
+    void setFree(IndexPair indices, bool free);
+    size_t findFreeRun(size_t numChunks) const;
+    void rebuildFreeBitmap() const; // Recomputes the bitmap and counters from the allocation table after an owner died
+
+    Header* header;
+    uint64_t* allocationEnds; // End chunk of the allocation starting at each chunk, 0 if none starts there
+    uint64_t* freeBitmap; // One bit per chunk, set when free
+    uint8_t* data;
+};
+
+#endif //KOKKOS_MEMORY_POOL_OFFSETPOOL_HPP
@@ -0,0 +1,131 @@
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PersistentPool.hpp"
+
+PersistentPool::PersistentPool(std::string path, size_t numChunks) : path(std::move(path)), reopened(false), pool([&] {
+    FileDescriptor fd(open(this->path.c_str(), O_RDWR));
+    if (fd.get() == -1 && errno != ENOENT) {
+        throw std::system_error(errno, std::generic_category(), "open " + this->path);
+    }
+
+    struct stat status{};
+    if (fd.get() != -1 && fstat(fd.get(), &status) == -1) {
+        throw std::system_error(errno, std::generic_category(), "fstat " + this->path);
+    }
+
+    // An empty file is what open(O_CREAT) leaves behind, so it is treated like a missing one
+    reopened = fd.get() != -1 && status.st_size > 0;
+    return reopened ? reopen(fd.get(), status.st_size) : create(numChunks);
+}()) {}
+
+PersistentPool::~PersistentPool() = default;
+
+OffsetPool PersistentPool::create(size_t numChunks) {
+    std::string temporaryPath = path + ".tmp";
+    size_t fileSize = OffsetPool::getRequiredBytes(numChunks);
+
+    FileDescriptor fd(open(temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644));
+    if (fd.get() == -1) {
+        throw std::system_error(errno, std::generic_category(), "open " + temporaryPath);
+    }
+
+    try {
+        if (ftruncate(fd.get(), fileSize) == -1) {
+            throw std::system_error(errno, std::generic_category(), "ftruncate " + temporaryPath);
+        }
+
+        mapping = SegmentMapping(fd.get(), fileSize);
+        OffsetPool newPool = OffsetPool::format(mapping.getData(), numChunks);
+
+        if (msync(mapping.getData(), fileSize, MS_SYNC) == -1) {
+            throw std::system_error(errno, std::generic_category(), "msync " + temporaryPath);
+        }
+
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "rename " + temporaryPath);
+        }
+
+        return newPool;
+    } catch (...) {
+        unlink(temporaryPath.c_str());
+        throw;
+    }
+}
+
+OffsetPool PersistentPool::reopen(int fd, size_t fileSize) {
+    mapping = SegmentMapping(fd, fileSize);
+
+    // The mutex in the file belonged to whichever process wrote it last
+    OffsetPool reopenedPool = OffsetPool::attach(mapping.getData(), fileSize);
+    reopenedPool.resetLock();
+    return reopenedPool;
+}
+
+size_t PersistentPool::allocate(size_t n) {
+    return pool.allocate(n);
+}
+
+void PersistentPool::deallocate(size_t offset) {
+    pool.deallocate(offset);
+}
+
+uint8_t *PersistentPool::getAddress(size_t offset) const {
+    return pool.getAddress(offset);
+}
+
+size_t PersistentPool::getOffset(const uint8_t *ptr) const {
+    return pool.getOffset(ptr);
+}
+
+void PersistentPool::setRoot(size_t index, size_t offset) {
+    pool.setRoot(index, offset);
+}
+
+size_t PersistentPool::getRoot(size_t index) const {
+    return pool.getRoot(index);
+}
+
+void PersistentPool::flush() {
+    if (msync(mapping.getData(), mapping.getSize(), MS_SYNC) == -1) {
+        throw std::system_error(errno, std::generic_category(), "msync " + path);
+    }
+}
+
+std::ostream &operator<<(std::ostream &os, const PersistentPool &pool) {
+    return os << pool.pool;
+}
+
+const std::string &PersistentPool::getPath() const {
+    return path;
+}
+
+bool PersistentPool::wasReopened() const {
+    return reopened;
+}
+
+unsigned PersistentPool::getNumAllocations() const {
+    return pool.getNumAllocations();
+}
+
+unsigned PersistentPool::getNumFreeChunks() const {
+    return pool.getNumFreeChunks();
+}
+
+unsigned PersistentPool::getNumAllocatedChunks() const {
+    return pool.getNumAllocatedChunks();
+}
+
+unsigned PersistentPool::getNumChunks() const {
+    return pool.getNumChunks();
+}
+
+unsigned PersistentPool::getNumFreeFragments() const {
+    return pool.getNumFreeFragments();
+}
@@ -0,0 +1,75 @@
+#ifndef KOKKOS_MEMORY_POOL_PERSISTENTPOOL_HPP
+#define KOKKOS_MEMORY_POOL_PERSISTENTPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "OffsetPool.hpp"
+#include "SegmentMapping.hpp"
+
+// Pool backed by a memory mapped file. The free bitmap and allocation table are stored in the file's header region, so
+// reopening the file after a restart restores every allocation at the same offset. Data is paged in lazily on first
+// access instead of being read up front. New files are formatted under a temporary name and only renamed to path once
+// written back, so a crash never leaves a half formatted pool behind.
+class PersistentPool {
+public:
+    static constexpr size_t INVALID_OFFSET = OffsetPool::INVALID_OFFSET;
+
+    // Reopens the file if it already holds a pool, ignoring numChunks. Throws if it holds anything else.
+    PersistentPool(std::string path, size_t numChunks);
+    ~PersistentPool();
+
+    PersistentPool(const PersistentPool&) = delete;
+    PersistentPool& operator=(const PersistentPool&) = delete;
+
+    size_t allocate(size_t n);
+    void deallocate(size_t offset);
+
+    uint8_t* getAddress(size_t offset) const;
+    size_t getOffset(const uint8_t* ptr) const;
+
+    void setRoot(size_t index, size_t offset);
+    size_t getRoot(size_t index) const;
+
+    void flush(); // Blocks until dirty pages and metadata are written back to the file
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n) {
+        size_t offset = allocate(n * sizeof(DataType));
+        return offset == INVALID_OFFSET ? Kokkos::View<DataType*, Kokkos::HostSpace>() : viewAt<DataType>(offset, n);
+    }
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> viewAt(size_t offset, size_t n) const {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(getAddress(offset)), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(getOffset(reinterpret_cast<uint8_t*>(view.data())));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const PersistentPool &pool);
+
+    const std::string& getPath() const;
+    bool wasReopened() const;
+
+    unsigned getNumAllocations() const;
+    unsigned getNumFreeChunks() const;
+    unsigned getNumAllocatedChunks() const;
+    unsigned getNumChunks() const;
+    unsigned getNumFreeFragments() const;
+
+private:
+    OffsetPool create(size_t numChunks);
+    OffsetPool reopen(int fd, size_t fileSize);
+
+    std::string path;
+    SegmentMapping mapping; // Declared before pool, so it is unmapped if building the pool throws
+    bool reopened;
+    OffsetPool pool;
+};
+
+#endif //KOKKOS_MEMORY_POOL_PERSISTENTPOOL_HPP
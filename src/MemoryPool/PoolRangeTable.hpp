@@ -0,0 +1,66 @@
+#ifndef KOKKOS_MEMORY_POOL_POOLRANGETABLE_HPP
+#define KOKKOS_MEMORY_POOL_POOLRANGETABLE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Finds what owns the sub-pool an address lies in without taking a lock. Adding a range publishes a new sorted copy
+// of the table through an atomic pointer, so lookups only load that pointer and binary search. Readers may still be
+// using older copies, so every copy is kept until the table is destroyed, which stays cheap because sub-pools are
+// few and at least double in size each time.
+template<typename Owner>
+class PoolRangeTable {
+public:
+    PoolRangeTable() = default;
+    PoolRangeTable(const PoolRangeTable&) = delete;
+    PoolRangeTable& operator=(const PoolRangeTable&) = delete;
+
+    void add(const uint8_t* begin, const uint8_t* end, Owner owner) {
+        std::lock_guard lock(mutex);
+
+        const Table* current = published.load(std::memory_order_relaxed);
+        auto table = current ? std::make_unique<Table>(*current) : std::make_unique<Table>();
+
+        auto rangeItr = std::upper_bound(table->begin(), table->end(), begin, [](const uint8_t* data, const Range& range) {
+            return data < range.begin;
+        });
+        table->insert(rangeItr, {begin, end, owner});
+
+        published.store(table.get(), std::memory_order_release);
+        tables.push_back(std::move(table));
+    }
+
+    // data must lie in a range added before the caller got hold of data
+    Owner find(const uint8_t* data) const {
+        const Table& table = *published.load(std::memory_order_acquire);
+
+        auto rangeItr = std::upper_bound(table.begin(), table.end(), data, [](const uint8_t* data, const Range& range) {
+            return data < range.begin;
+        });
+        assert(rangeItr != table.begin());
+        rangeItr--;
+
+        assert(data < rangeItr->end);
+        return rangeItr->owner;
+    }
+
+private:
+    struct Range {
+        const uint8_t* begin;
+        const uint8_t* end;
+        Owner owner;
+    };
+
+    using Table = std::vector<Range>;
+
+    std::mutex mutex; // Only serializes add
+    std::vector<std::unique_ptr<Table>> tables;
+    std::atomic<const Table*> published = nullptr;
+};
+
+#endif //KOKKOS_MEMORY_POOL_POOLRANGETABLE_HPP
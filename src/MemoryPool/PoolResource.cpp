@@ -0,0 +1,60 @@
+#include "PoolResource.hpp"
+
+MultiPoolResource::MultiPoolResource(HostMultiPool &pool) : pool(pool) {}
+
+HostMultiPool &MultiPoolResource::getPool() const {
+    return pool;
+}
+
+void *MultiPoolResource::do_allocate(size_t bytes, size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+
+    uint8_t* ptr = pool.allocate(bytes);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+
+    if (reinterpret_cast<uintptr_t>(ptr) % alignment == 0) {
+        return ptr;
+    }
+
+    // Chunks are only as aligned as the backing view, so over-allocate and remember where the block really starts
+    pool.deallocate(ptr);
+    ptr = pool.allocate(bytes + alignment - 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    auto* aligned = reinterpret_cast<uint8_t*>((address + alignment - 1) / alignment * alignment);
+    overAlignedAllocations[aligned] = ptr;
+
+    return aligned;
+}
+
+void MultiPoolResource::do_deallocate(void *p, size_t bytes, size_t alignment) {
+    auto* ptr = static_cast<uint8_t*>(p);
+
+    // Mirrors do_allocate, so the pool can free the block by size alone
+    if (bytes == 0) {
+        bytes = 1;
+    }
+
+    if (!overAlignedAllocations.empty()) {
+        auto overAlignedItr = overAlignedAllocations.find(ptr);
+        if (overAlignedItr != overAlignedAllocations.end()) {
+            ptr = overAlignedItr->second;
+            bytes += alignment - 1;
+            overAlignedAllocations.erase(overAlignedItr);
+        }
+    }
+
+    pool.deallocate(ptr, bytes);
+}
+
+bool MultiPoolResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    const auto* otherResource = dynamic_cast<const MultiPoolResource*>(&other);
+    return otherResource && (&otherResource->pool == &pool);
+}
@@ -0,0 +1,70 @@
+#ifndef KOKKOS_MEMORY_POOL_POOLRESOURCE_HPP
+#define KOKKOS_MEMORY_POOL_POOLRESOURCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <new>
+
+#include "MemoryPool.hpp"
+
+// Exposes a host pool to standard containers. Like the pool itself, this is not thread safe.
+class MultiPoolResource : public std::pmr::memory_resource {
+public:
+    explicit MultiPoolResource(HostMultiPool& pool);
+
+    HostMultiPool& getPool() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    HostMultiPool& pool;
+    std::map<uint8_t*, uint8_t*> overAlignedAllocations; // Aligned pointer handed out -> pointer from the pool
+};
+
+// Classic allocator for code that cannot use std::pmr containers.
+template<typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(MultiPoolResource& resource) noexcept : resource(&resource) {}
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : resource(other.getResource()) {}
+
+    T* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+
+        return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    MultiPoolResource* getResource() const noexcept {
+        return resource;
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept {
+        return resource == other.getResource();
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>& other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    MultiPoolResource* resource;
+};
+
+#endif //KOKKOS_MEMORY_POOL_POOLRESOURCE_HPP
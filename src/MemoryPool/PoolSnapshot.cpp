@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "PoolSnapshot.hpp"
+
+namespace {
+constexpr uint64_t SNAPSHOT_MAGIC = 0x4b4b4d50534e4150; // "KKMPSNAP"
+constexpr uint64_t SNAPSHOT_VERSION = 1;
+constexpr size_t FILE_ALIGNMENT = 4096;
+constexpr size_t MAX_PIECE_SIZE = 64 * 1024 * 1024; // Large enough to stream, small enough to balance threads
+
+struct SnapshotPiece {
+    uint8_t* data;
+    size_t bytes;
+    size_t fileOffset;
+};
+
+size_t roundUp(size_t n, size_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+void writeValue(std::ostream& os, uint64_t value) {
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint64_t readValue(std::istream& is) {
+    uint64_t value = 0;
+    is.read(reinterpret_cast<char*>(&value), sizeof(value));
+
+    if (!is) {
+        throw std::runtime_error("Truncated pool snapshot");
+    }
+
+    return value;
+}
+
+void writeRanges(std::ostream& os, const std::vector<std::pair<size_t, size_t>>& ranges) {
+    writeValue(os, ranges.size());
+
+    for (auto [beginIndex, endIndex] : ranges) {
+        writeValue(os, beginIndex);
+        writeValue(os, endIndex);
+    }
+}
+
+std::vector<std::pair<size_t, size_t>> readRanges(std::istream& is) {
+    std::vector<std::pair<size_t, size_t>> ranges(readValue(is));
+
+    for (auto& [beginIndex, endIndex] : ranges) {
+        beginIndex = readValue(is);
+        endIndex = readValue(is);
+    }
+
+    return ranges;
+}
+
+// Ranges must be sorted, disjoint, non-empty and inside the pool, otherwise restoring them would write out of bounds
+void validateRanges(const std::vector<std::pair<size_t, size_t>>& ranges, uint64_t numChunks, const std::string& path) {
+    size_t previousEndIndex = 0;
+
+    for (auto [beginIndex, endIndex] : ranges) {
+        if (beginIndex < previousEndIndex || beginIndex >= endIndex || endIndex > numChunks) {
+            throw std::runtime_error(path + " has ranges outside of its pools");
+        }
+
+        previousEndIndex = endIndex;
+    }
+}
+
+size_t getDataOffset(const std::vector<PoolSnapshotInfo>& pools) {
+    size_t metadataValues = 4; // Magic, version, chunk size and pool count
+
+    for (const auto& pool : pools) {
+        metadataValues += 4 + (2 * pool.allocations.size()) + (2 * pool.allocatedRuns.size());
+    }
+
+    return roundUp(metadataValues * sizeof(uint64_t), FILE_ALIGNMENT);
+}
+
+// Data follows the metadata in run order, every run starting on an aligned offset
+std::vector<SnapshotPiece> getPieces(size_t dataOffset, size_t chunkSize, const std::vector<PoolSnapshotInfo>& pools,
+                                     const std::vector<uint8_t*>& baseAddresses) {
+    std::vector<SnapshotPiece> pieces;
+    size_t fileOffset = dataOffset;
+
+    for (size_t i = 0; i < pools.size(); i++) {
+        for (auto [beginIndex, endIndex] : pools[i].allocatedRuns) {
+            uint8_t* data = baseAddresses[i] + (beginIndex * chunkSize);
+            size_t bytes = (endIndex - beginIndex) * chunkSize;
+
+            for (size_t pieceOffset = 0; pieceOffset < bytes; pieceOffset += MAX_PIECE_SIZE) {
+                pieces.push_back({data + pieceOffset, std::min(MAX_PIECE_SIZE, bytes - pieceOffset), fileOffset + pieceOffset});
+            }
+
+            fileOffset = roundUp(fileOffset + bytes, FILE_ALIGNMENT);
+        }
+    }
+
+    return pieces;
+}
+
+template<typename IOFunc>
+void transferPieces(const std::string& path, int flags, const std::vector<SnapshotPiece>& pieces, unsigned numThreads, IOFunc io) {
+    int fd = open(path.c_str(), flags, 0644);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+
+    std::atomic<size_t> nextPiece = 0;
+    std::atomic<int> error = 0;
+
+    auto worker = [&] {
+        for (size_t i = nextPiece++; (i < pieces.size()) && !error; i = nextPiece++) {
+            auto [data, bytes, fileOffset] = pieces[i];
+
+            while (bytes > 0) {
+                ssize_t transferred = io(fd, data, bytes, fileOffset);
+
+                if (transferred <= 0) {
+                    error = transferred == 0 ? EIO : errno;
+                    break;
+                }
+
+                data += transferred;
+                bytes -= transferred;
+                fileOffset += transferred;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::max(numThreads, 1U); i++) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    close(fd);
+
+    if (error) {
+        throw std::system_error(error, std::generic_category(), "Pool snapshot I/O on " + path);
+    }
+}
+}
+
+void writePoolSnapshot(const std::string &path, size_t chunkSize, const std::vector<PoolSnapshotInfo> &pools,
+                       const std::vector<uint8_t*> &baseAddresses, unsigned numThreads) {
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Could not open pool snapshot " + path);
+        }
+
+        writeValue(file, SNAPSHOT_MAGIC);
+        writeValue(file, SNAPSHOT_VERSION);
+        writeValue(file, chunkSize);
+        writeValue(file, pools.size());
+
+        for (const auto& pool : pools) {
+            writeValue(file, pool.numChunks);
+            writeValue(file, pool.baseAddress);
+            writeRanges(file, pool.allocations);
+            writeRanges(file, pool.allocatedRuns);
+        }
+
+    }
+
+    transferPieces(path, O_WRONLY, getPieces(getDataOffset(pools), chunkSize, pools, baseAddresses), numThreads,
+                   [](int fd, uint8_t* data, size_t bytes, size_t offset) { return pwrite(fd, data, bytes, offset); });
+}
+
+std::vector<PoolSnapshotInfo> readPoolSnapshotInfo(const std::string &path, size_t chunkSize) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open pool snapshot " + path);
+    }
+
+    if (readValue(file) != SNAPSHOT_MAGIC || readValue(file) != SNAPSHOT_VERSION) {
+        throw std::runtime_error(path + " is not a pool snapshot");
+    }
+
+    if (readValue(file) != chunkSize) {
+        throw std::runtime_error(path + " was taken with a different chunk size");
+    }
+
+    std::vector<PoolSnapshotInfo> pools(readValue(file));
+
+    for (auto& pool : pools) {
+        pool.numChunks = readValue(file);
+        pool.baseAddress = readValue(file);
+        pool.allocations = readRanges(file);
+        pool.allocatedRuns = readRanges(file);
+
+        validateRanges(pool.allocations, pool.numChunks, path);
+        validateRanges(pool.allocatedRuns, pool.numChunks, path);
+    }
+
+    return pools;
+}
+
+void readPoolSnapshotData(const std::string &path, size_t chunkSize, const std::vector<PoolSnapshotInfo> &pools,
+                          const std::vector<uint8_t*> &baseAddresses, unsigned numThreads) {
+    transferPieces(path, O_RDONLY, getPieces(getDataOffset(pools), chunkSize, pools, baseAddresses), numThreads,
+                   [](int fd, uint8_t* data, size_t bytes, size_t offset) { return pread(fd, data, bytes, offset); });
+}
@@ -0,0 +1,30 @@
+#ifndef KOKKOS_MEMORY_POOL_POOLSNAPSHOT_HPP
+#define KOKKOS_MEMORY_POOL_POOLSNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Layout of one sub-pool inside a snapshot file
+struct PoolSnapshotInfo {
+    uint64_t numChunks;
+    uint64_t baseAddress; // Address of the sub-pool when the snapshot was taken
+    std::vector<std::pair<size_t, size_t>> allocations; // [begin, end) chunk indices
+    std::vector<std::pair<size_t, size_t>> allocatedRuns; // Maximal allocated spans, the only data written
+};
+
+// Writes the metadata followed by every allocated run, each starting on a page aligned file offset. Runs are split into
+// large pieces that numThreads threads write concurrently with pwrite.
+void writePoolSnapshot(const std::string& path, size_t chunkSize, const std::vector<PoolSnapshotInfo>& pools,
+                       const std::vector<uint8_t*>& baseAddresses, unsigned numThreads);
+
+// Throws when the file is not a snapshot taken with chunkSize, is truncated, or describes ranges outside of its pools
+std::vector<PoolSnapshotInfo> readPoolSnapshotInfo(const std::string& path, size_t chunkSize);
+
+// baseAddresses must point at sub-pools rebuilt from the info returned by readPoolSnapshotInfo
+void readPoolSnapshotData(const std::string& path, size_t chunkSize, const std::vector<PoolSnapshotInfo>& pools,
+                          const std::vector<uint8_t*>& baseAddresses, unsigned numThreads);
+
+#endif //KOKKOS_MEMORY_POOL_POOLSNAPSHOT_HPP
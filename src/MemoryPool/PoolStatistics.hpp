@@ -0,0 +1,60 @@
+#ifndef KOKKOS_MEMORY_POOL_POOLSTATISTICS_HPP
+#define KOKKOS_MEMORY_POOL_POOLSTATISTICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Allocation counters for the concurrent pools. Each thread updates a cache line padded slot of its own with relaxed
+// atomics, and reads add up every slot without taking any lock. A read is therefore not a snapshot of one instant:
+// each slot is sampled at a slightly different moment, so while threads are allocating the totals may be off by the
+// operations in flight, e.g. count a free but not its allocation. Once the pool is quiescent they are exact.
+class PoolStatistics {
+public:
+    static constexpr unsigned NUM_SLOTS = 64; // Threads beyond this share slots, which stays correct but may contend
+
+    void recordAllocation(size_t numChunks) {
+        Slot& slot = slots[getSlotIndex()];
+        slot.numAllocations.fetch_add(1, std::memory_order_relaxed);
+        slot.numAllocatedChunks.fetch_add(numChunks, std::memory_order_relaxed);
+    }
+
+    void recordDeallocation(size_t numChunks) {
+        Slot& slot = slots[getSlotIndex()];
+        slot.numAllocations.fetch_sub(1, std::memory_order_relaxed);
+        slot.numAllocatedChunks.fetch_sub(numChunks, std::memory_order_relaxed);
+    }
+
+    unsigned getNumAllocations() const { return sum(&Slot::numAllocations); }
+    unsigned getNumAllocatedChunks() const { return sum(&Slot::numAllocatedChunks); }
+
+private:
+    // Signed because a block is often freed on a different thread, and so a different slot, than it was allocated on
+    struct alignas(64) Slot {
+        std::atomic<int64_t> numAllocations = 0;
+        std::atomic<int64_t> numAllocatedChunks = 0;
+    };
+
+    static unsigned getSlotIndex() {
+        static std::atomic<unsigned> nextSlotIndex = 0;
+        thread_local unsigned slotIndex = nextSlotIndex.fetch_add(1, std::memory_order_relaxed) % NUM_SLOTS;
+
+        return slotIndex;
+    }
+
+    unsigned sum(std::atomic<int64_t> Slot::*counter) const {
+        int64_t total = 0;
+
+        for (const Slot& slot : slots) {
+            total += (slot.*counter).load(std::memory_order_relaxed);
+        }
+
+        return std::max<int64_t>(total, 0); // A sample taken mid-flight can briefly see more frees than allocations
+    }
+
+    std::array<Slot, NUM_SLOTS> slots;
+};
+
+#endif //KOKKOS_MEMORY_POOL_POOLSTATISTICS_HPP
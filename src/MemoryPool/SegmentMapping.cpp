@@ -0,0 +1,61 @@
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "SegmentMapping.hpp"
+
+FileDescriptor::FileDescriptor(int fd) : fd(fd) {}
+
+FileDescriptor::~FileDescriptor() {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+int FileDescriptor::get() const {
+    return fd;
+}
+
+SegmentMapping::SegmentMapping(int fd, size_t bytes) {
+    void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (address == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+
+    data = static_cast<uint8_t*>(address);
+    size = bytes;
+}
+
+SegmentMapping::~SegmentMapping() {
+    if (data) {
+        munmap(data, size);
+    }
+}
+
+SegmentMapping::SegmentMapping(SegmentMapping &&other) noexcept
+        : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+SegmentMapping &SegmentMapping::operator=(SegmentMapping &&other) noexcept {
+    if (this != &other) {
+        if (data) {
+            munmap(data, size);
+        }
+
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+
+    return *this;
+}
+
+uint8_t *SegmentMapping::getData() const {
+    return data;
+}
+
+size_t SegmentMapping::getSize() const {
+    return size;
+}
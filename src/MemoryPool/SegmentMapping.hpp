@@ -0,0 +1,40 @@
+#ifndef KOKKOS_MEMORY_POOL_SEGMENTMAPPING_HPP
+#define KOKKOS_MEMORY_POOL_SEGMENTMAPPING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Closes a file descriptor when destroyed. Holds -1 if the open call it wraps failed.
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd);
+    ~FileDescriptor();
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    int get() const;
+
+private:
+    int fd;
+};
+
+// Owns a shared read-write mapping of a file or shared memory object and unmaps it when destroyed
+class SegmentMapping {
+public:
+    SegmentMapping() = default;
+    SegmentMapping(int fd, size_t bytes); // Throws std::system_error if the mapping fails
+    ~SegmentMapping();
+
+    SegmentMapping(SegmentMapping&& other) noexcept;
+    SegmentMapping& operator=(SegmentMapping&& other) noexcept;
+
+    uint8_t* getData() const;
+    size_t getSize() const;
+
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+#endif //KOKKOS_MEMORY_POOL_SEGMENTMAPPING_HPP
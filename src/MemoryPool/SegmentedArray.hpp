@@ -0,0 +1,145 @@
+#ifndef KOKKOS_MEMORY_POOL_SEGMENTEDARRAY_HPP
+#define KOKKOS_MEMORY_POOL_SEGMENTEDARRAY_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "MemoryPool.hpp"
+
+// Growable array on top of a MultiPool, split into segments of 2^log2SegmentSize elements that are each a block of
+// their own. Growing only adds segments, so elements never move and no contiguous run is needed for the whole array.
+// The segment table has room for maxSegments and is allocated up front, so an Accessor taken before growing still
+// sees every element afterwards. Elements are never constructed or destructed, as with a View.
+template<typename T, typename MemorySpace = Kokkos::HostSpace>
+class SegmentedArray {
+public:
+    static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace, MemorySpace>::accessible, "The segment table is written on the host");
+    static_assert(std::is_trivially_copyable_v<T>, "Elements are never constructed or destructed");
+    static_assert(alignof(T) <= BasicMemoryPool<MemorySpace>::CHUNK_ALIGNMENT, "Segments are only aligned to chunks");
+
+    static constexpr size_t DEFAULT_SEGMENT_BYTES = 64 * 1024;
+
+    // Copyable handle for kernels. Reads the segment table on every access, so it stays valid while the array grows.
+    class Accessor {
+    public:
+        KOKKOS_INLINE_FUNCTION T& operator()(size_t i) const {
+            return segments[i >> log2SegmentSize][i & segmentMask];
+        }
+
+    private:
+        friend class SegmentedArray;
+
+        Accessor(T* const* segments, unsigned log2SegmentSize)
+                : segments(segments), log2SegmentSize(log2SegmentSize), segmentMask((size_t{1} << log2SegmentSize) - 1) {}
+
+        T* const* segments;
+        unsigned log2SegmentSize;
+        size_t segmentMask;
+    };
+
+    // Throws std::length_error when the segment table would not fit in size_t bytes and std::invalid_argument when a
+    // segment of 2^log2SegmentSize elements would not
+    SegmentedArray(BasicMultiPool<MemorySpace>& pool, size_t maxSegments, unsigned log2SegmentSize = getDefaultLog2SegmentSize())
+            : pool(pool), maxSegments(maxSegments), log2SegmentSize(log2SegmentSize),
+              segments(allocateSegmentTable(pool, maxSegments, log2SegmentSize)) {}
+
+    ~SegmentedArray() {
+        releaseSegments(0);
+        pool.deallocate(reinterpret_cast<uint8_t*>(segments));
+    }
+
+    SegmentedArray(const SegmentedArray&) = delete;
+    SegmentedArray& operator=(const SegmentedArray&) = delete;
+
+    KOKKOS_INLINE_FUNCTION T& operator()(size_t i) const {
+        assert(i < numElements);
+        return segments[i >> log2SegmentSize][i & (getSegmentSize() - 1)];
+    }
+
+    Accessor getAccessor() const {
+        return Accessor(segments, log2SegmentSize);
+    }
+
+    // Throws std::length_error once the segment table is full
+    void reserve(size_t n) {
+        size_t requiredSegments = getRequiredSegments(n);
+        if (requiredSegments > maxSegments) {
+            throw std::length_error("SegmentedArray needs more segments than its table holds");
+        }
+
+        while (numSegments < requiredSegments) {
+            segments[numSegments++] = reinterpret_cast<T*>(pool.allocate(getSegmentSize() * sizeof(T)));
+        }
+    }
+
+    // Keeps the segments when shrinking, see shrinkToFit
+    void resize(size_t n) {
+        reserve(n);
+        numElements = n;
+    }
+
+    void pushBack(const T& value) {
+        reserve(numElements + 1);
+        segments[numElements >> log2SegmentSize][numElements & (getSegmentSize() - 1)] = value;
+        numElements++;
+    }
+
+    // Returns the segments past the last element to the pool
+    void shrinkToFit() {
+        releaseSegments(getRequiredSegments(numElements));
+    }
+
+    size_t getSize() const { return numElements; }
+    size_t getCapacity() const { return numSegments << log2SegmentSize; }
+    size_t getNumSegments() const { return numSegments; }
+    size_t getMaxSegments() const { return maxSegments; }
+    KOKKOS_INLINE_FUNCTION size_t getSegmentSize() const { return size_t{1} << log2SegmentSize; }
+
+    // The largest power of two number of elements that fits in DEFAULT_SEGMENT_BYTES, at least one
+    static constexpr unsigned getDefaultLog2SegmentSize() {
+        unsigned log2 = 0;
+
+        while ((size_t{2} << log2) * sizeof(T) <= DEFAULT_SEGMENT_BYTES) {
+            log2++;
+        }
+
+        return log2;
+    }
+
+private:
+    static T** allocateSegmentTable(BasicMultiPool<MemorySpace>& pool, size_t maxSegments, unsigned log2SegmentSize) {
+        if (maxSegments > std::numeric_limits<size_t>::max() / sizeof(T*)) {
+            throw std::length_error("SegmentedArray segment table is larger than size_t");
+        }
+
+        if (log2SegmentSize >= std::numeric_limits<size_t>::digits || (std::numeric_limits<size_t>::max() >> log2SegmentSize) < sizeof(T)) {
+            throw std::invalid_argument("SegmentedArray segments of 2^log2SegmentSize elements are larger than size_t");
+        }
+
+        return reinterpret_cast<T**>(pool.allocate(maxSegments * sizeof(T*)));
+    }
+
+    // Rounds up without computing n + getSegmentSize() - 1, which overflows for n close to SIZE_MAX
+    size_t getRequiredSegments(size_t n) const {
+        return (n >> log2SegmentSize) + ((n & (getSegmentSize() - 1)) != 0);
+    }
+
+    void releaseSegments(size_t keptSegments) {
+        while (numSegments > keptSegments) {
+            pool.deallocate(reinterpret_cast<uint8_t*>(segments[--numSegments]));
+        }
+    }
+
+    BasicMultiPool<MemorySpace>& pool;
+    size_t maxSegments;
+    unsigned log2SegmentSize;
+    T** segments;
+    size_t numSegments = 0;
+    size_t numElements = 0;
+};
+
+#endif //KOKKOS_MEMORY_POOL_SEGMENTEDARRAY_HPP
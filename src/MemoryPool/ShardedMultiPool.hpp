@@ -0,0 +1,166 @@
+#ifndef KOKKOS_MEMORY_POOL_SHARDEDMULTIPOOL_HPP
+#define KOKKOS_MEMORY_POOL_SHARDEDMULTIPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+#include "PoolRangeTable.hpp"
+#include "PoolStatistics.hpp"
+
+// Thread safe MultiPool split into independent shards, each behind its own lock. Threads are assigned home shards
+// round-robin and move on to the following shards only when their home shard has no room, growing the home shard once
+// every shard is full. Deallocation finds the shard through a lock-free PoolRangeTable, so any thread may free any
+// block. The allocation counts come from PoolStatistics and never take a shard's lock, see there for what a read
+// observes. Shards grow on whichever thread allocates, so they are built with PoolOptions::clearWithMemset and host
+// shards never launch a Kokkos kernel.
+template<typename MemorySpace = Kokkos::HostSpace>
+class ShardedMultiPool {
+public:
+    explicit ShardedMultiPool(size_t initialChunksPerShard, unsigned numShards = std::thread::hardware_concurrency()) {
+        numShards = std::max(numShards, 1u);
+
+        for (unsigned index = 0; index < numShards; index++) {
+            shards.push_back(std::make_unique<Shard>(initialChunksPerShard, [this, index](BasicMemoryPool<MemorySpace>& pool) {
+                registerPool(pool, index);
+            }));
+        }
+    }
+
+    ShardedMultiPool(const ShardedMultiPool&) = delete;
+    ShardedMultiPool& operator=(const ShardedMultiPool&) = delete;
+
+    uint8_t* allocate(size_t n) {
+        if (uint8_t* ptr = tryAllocate(n)) {
+            return ptr;
+        }
+
+        auto& shard = *shards[getHomeShard()];
+        uint8_t* ptr;
+
+        {
+            std::lock_guard lock(shard.mutex);
+            ptr = shard.pool.allocate(n);
+        }
+
+        statistics.recordAllocation(BasicMemoryPool<MemorySpace>::getRequiredChunks(n));
+        return ptr;
+    }
+
+    // Only uses the shards' existing sub-pools, returns nullptr instead of growing
+    uint8_t* tryAllocate(size_t n) {
+        unsigned homeShard = getHomeShard();
+
+        for (unsigned offset = 0; offset < shards.size(); offset++) {
+            auto& shard = *shards[(homeShard + offset) % shards.size()];
+
+            std::unique_lock lock(shard.mutex);
+            if (uint8_t* ptr = shard.pool.tryAllocate(n)) {
+                lock.unlock();
+
+                statistics.recordAllocation(BasicMemoryPool<MemorySpace>::getRequiredChunks(n));
+                return ptr;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void deallocate(uint8_t* data) {
+        auto& shard = *shards[getShardOf(data)];
+        size_t numChunks;
+
+        {
+            std::lock_guard lock(shard.mutex);
+            numChunks = shard.pool.getAllocationSize(data);
+            shard.pool.deallocate(data);
+        }
+
+        statistics.recordDeallocation(numChunks);
+    }
+
+    template<typename DataType>
+    Kokkos::View<DataType*, MemorySpace> allocateView(size_t n) {
+        return Kokkos::View<DataType*, MemorySpace>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType))), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const ShardedMultiPool &shardedPool) {
+        for (unsigned index = 0; index < shardedPool.shards.size(); index++) {
+            std::lock_guard lock(shardedPool.shards[index]->mutex);
+            os << "Shard " << index << ": " << shardedPool.shards[index]->pool << '\n';
+        }
+
+        return os;
+    }
+
+    unsigned getNumShards() const { return shards.size(); }
+
+    unsigned getHomeShard() const {
+        static std::atomic<unsigned> nextThreadIndex = 0;
+        thread_local unsigned threadIndex = nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+
+        return threadIndex % shards.size();
+    }
+
+    unsigned getShardOf(const uint8_t* data) const {
+        return ranges.find(data);
+    }
+
+    unsigned getNumAllocations() const { return statistics.getNumAllocations(); }
+    unsigned getNumFreeChunks() const { return sumOverShards(&BasicMultiPool<MemorySpace>::getNumFreeChunks); }
+    unsigned getNumAllocatedChunks() const { return statistics.getNumAllocatedChunks(); }
+    unsigned getNumChunks() const { return sumOverShards(&BasicMultiPool<MemorySpace>::getNumChunks); }
+    unsigned getNumFreeFragments() const { return sumOverShards(&BasicMultiPool<MemorySpace>::getNumFreeFragments); }
+
+private:
+    // Padded so the locks of neighbouring shards never share a cache line
+    struct alignas(64) Shard {
+        Shard(size_t initialChunks, typename BasicMultiPool<MemorySpace>::PoolInitializer initializer)
+                : pool(initialChunks, getShardOptions(), std::move(initializer)) {}
+
+        static PoolOptions getShardOptions() {
+            PoolOptions options;
+            options.clearWithMemset = true;
+            return options;
+        }
+
+        mutable std::mutex mutex;
+        BasicMultiPool<MemorySpace> pool;
+    };
+
+    void registerPool(BasicMemoryPool<MemorySpace>& pool, unsigned index) {
+        ranges.add(pool.getBaseAddress(), pool.getBaseAddress() + pool.getSizeInBytes(), index);
+    }
+
+    unsigned sumOverShards(unsigned (BasicMultiPool<MemorySpace>::*getter)() const) const {
+        unsigned sum = 0;
+
+        for (const auto& shard : shards) {
+            std::lock_guard lock(shard->mutex);
+            sum += (shard->pool.*getter)();
+        }
+
+        return sum;
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    PoolRangeTable<unsigned> ranges; // Sub-pool -> shard
+
+    PoolStatistics statistics;
+};
+
+#endif //KOKKOS_MEMORY_POOL_SHARDEDMULTIPOOL_HPP
@@ -0,0 +1,151 @@
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SharedMemoryPool.hpp"
+
+namespace {
+int openSegment(const std::string& name, int flags) {
+    int fd = shm_open(name.c_str(), flags, 0600);
+
+    if (fd == -1 && !(errno == EEXIST && (flags & O_EXCL))) {
+        throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+    }
+
+    return fd;
+}
+
+void throwIfPast(std::chrono::steady_clock::time_point deadline, const std::string& name) {
+    if (std::chrono::steady_clock::now() > deadline) {
+        throw std::runtime_error("Timed out waiting for shared memory segment " + name + " to be formatted");
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+// Waits for the creating process to size the segment
+size_t waitForSegment(int fd, std::chrono::steady_clock::time_point deadline, const std::string& name) {
+    struct stat status{};
+
+    while (true) {
+        if (fstat(fd, &status) == -1) {
+            throw std::system_error(errno, std::generic_category(), "fstat");
+        }
+
+        if (status.st_size > 0) {
+            return status.st_size;
+        }
+
+        throwIfPast(deadline, name);
+    }
+}
+
+int createOrOpen(const std::string& name, size_t numChunks, bool& created) {
+    int fd = openSegment(name, O_RDWR | O_CREAT | O_EXCL);
+    created = fd != -1;
+
+    if (!created) {
+        return openSegment(name, O_RDWR);
+    }
+
+    if (ftruncate(fd, OffsetPool::getRequiredBytes(numChunks)) == -1) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::system_error(error, std::generic_category(), "ftruncate");
+    }
+
+    return fd;
+}
+}
+
+SharedMemoryPool::SharedMemoryPool(std::string name, size_t numChunks, std::chrono::milliseconds attachTimeout) : name(std::move(name)), pool([&] {
+    bool created = false;
+    FileDescriptor fd(createOrOpen(this->name, numChunks, created));
+
+    if (!created) {
+        return attach(fd.get(), attachTimeout);
+    }
+
+    // Unlinked on failure, so later processes create a fresh segment instead of waiting on this one
+    try {
+        mapping = SegmentMapping(fd.get(), OffsetPool::getRequiredBytes(numChunks));
+        return OffsetPool::format(mapping.getData(), numChunks);
+    } catch (...) {
+        shm_unlink(this->name.c_str());
+        throw;
+    }
+}()) {}
+
+SharedMemoryPool::SharedMemoryPool(std::string name, std::chrono::milliseconds attachTimeout) : name(std::move(name)), pool([&] {
+    FileDescriptor fd(openSegment(this->name, O_RDWR));
+    return attach(fd.get(), attachTimeout);
+}()) {}
+
+SharedMemoryPool::~SharedMemoryPool() = default;
+
+OffsetPool SharedMemoryPool::attach(int fd, std::chrono::milliseconds attachTimeout) {
+    auto deadline = std::chrono::steady_clock::now() + attachTimeout;
+    mapping = SegmentMapping(fd, waitForSegment(fd, deadline, name));
+
+    while (!OffsetPool::isFormatted(mapping.getData(), mapping.getSize())) {
+        throwIfPast(deadline, name);
+    }
+
+    return OffsetPool::attach(mapping.getData(), mapping.getSize());
+}
+
+void SharedMemoryPool::remove(const std::string &name) {
+    shm_unlink(name.c_str());
+}
+
+size_t SharedMemoryPool::allocate(size_t n) {
+    return pool.allocate(n);
+}
+
+void SharedMemoryPool::deallocate(size_t offset) {
+    pool.deallocate(offset);
+}
+
+uint8_t *SharedMemoryPool::getAddress(size_t offset) const {
+    return pool.getAddress(offset);
+}
+
+size_t SharedMemoryPool::getOffset(const uint8_t *ptr) const {
+    return pool.getOffset(ptr);
+}
+
+std::ostream &operator<<(std::ostream &os, const SharedMemoryPool &pool) {
+    return os << pool.pool;
+}
+
+const std::string &SharedMemoryPool::getName() const {
+    return name;
+}
+
+unsigned SharedMemoryPool::getNumAllocations() const {
+    return pool.getNumAllocations();
+}
+
+unsigned SharedMemoryPool::getNumFreeChunks() const {
+    return pool.getNumFreeChunks();
+}
+
+unsigned SharedMemoryPool::getNumAllocatedChunks() const {
+    return pool.getNumAllocatedChunks();
+}
+
+unsigned SharedMemoryPool::getNumChunks() const {
+    return pool.getNumChunks();
+}
+
+unsigned SharedMemoryPool::getNumFreeFragments() const {
+    return pool.getNumFreeFragments();
+}
@@ -0,0 +1,72 @@
+#ifndef KOKKOS_MEMORY_POOL_SHAREDMEMORYPOOL_HPP
+#define KOKKOS_MEMORY_POOL_SHAREDMEMORYPOOL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "OffsetPool.hpp"
+#include "SegmentMapping.hpp"
+
+// Pool living in a POSIX shared memory segment. Every process that constructs a SharedMemoryPool with the same name
+// maps the same chunks, so an offset returned by allocate in one process can be resolved with getAddress or viewAt in
+// another and the data shared without copies.
+class SharedMemoryPool {
+public:
+    static constexpr size_t INVALID_OFFSET = OffsetPool::INVALID_OFFSET;
+    static constexpr std::chrono::milliseconds DEFAULT_ATTACH_TIMEOUT = std::chrono::seconds(10);
+
+    // Creates the segment, or attaches if it already exists. Attaching waits up to attachTimeout for the creating
+    // process to format the segment and throws after that, e.g. because that process died first.
+    SharedMemoryPool(std::string name, size_t numChunks, std::chrono::milliseconds attachTimeout = DEFAULT_ATTACH_TIMEOUT);
+    explicit SharedMemoryPool(std::string name, std::chrono::milliseconds attachTimeout = DEFAULT_ATTACH_TIMEOUT); // Attaches to an existing segment
+    ~SharedMemoryPool();
+
+    SharedMemoryPool(const SharedMemoryPool&) = delete;
+    SharedMemoryPool& operator=(const SharedMemoryPool&) = delete;
+
+    static void remove(const std::string& name); // Unlinks the segment, existing mappings stay valid
+
+    size_t allocate(size_t n);
+    void deallocate(size_t offset);
+
+    uint8_t* getAddress(size_t offset) const;
+    size_t getOffset(const uint8_t* ptr) const;
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n) {
+        size_t offset = allocate(n * sizeof(DataType));
+        return offset == INVALID_OFFSET ? Kokkos::View<DataType*, Kokkos::HostSpace>() : viewAt<DataType>(offset, n);
+    }
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> viewAt(size_t offset, size_t n) const {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(getAddress(offset)), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(getOffset(reinterpret_cast<uint8_t*>(view.data())));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const SharedMemoryPool &pool);
+
+    const std::string& getName() const;
+
+    unsigned getNumAllocations() const;
+    unsigned getNumFreeChunks() const;
+    unsigned getNumAllocatedChunks() const;
+    unsigned getNumChunks() const;
+    unsigned getNumFreeFragments() const;
+
+private:
+    OffsetPool attach(int fd, std::chrono::milliseconds attachTimeout);
+
+    std::string name;
+    SegmentMapping mapping; // Declared before pool, so it is unmapped if building the pool throws
+    OffsetPool pool;
+};
+
+#endif //KOKKOS_MEMORY_POOL_SHAREDMEMORYPOOL_HPP
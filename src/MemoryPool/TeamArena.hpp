@@ -0,0 +1,87 @@
+#ifndef KOKKOS_MEMORY_POOL_TEAMARENA_HPP
+#define KOKKOS_MEMORY_POOL_TEAMARENA_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "MemoryPool.hpp"
+
+// Team scratch memory sized at run time for TeamPolicy kernels on host backends. Every thread of a team constructs the
+// arena with the same arguments, which makes one thread of the team take a single block from pool. Threads then
+// sub-allocate from it with a bump pointer shared only within the team, so an allocation costs one uncontended atomic
+// add. The block goes back to pool once the whole team has destroyed the arena. Pool must be thread safe, e.g. a
+// ShardedMultiPool, and sub-allocations live only as long as the arena. Growing a pool launches Kokkos work, which
+// cannot be nested inside a kernel, so the block is taken with tryAllocate and pool must be sized up front to hold the
+// blocks of every team that can run at once. If it is not, this asserts, and without assertions the arena is empty.
+template<typename Pool, typename TeamMember>
+class TeamArena {
+public:
+    static constexpr size_t HEADER_SIZE = 64; // Keeps the bump pointer on its own cache line
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    TeamArena(Pool& pool, const TeamMember& team, size_t bytesPerTeam)
+            : pool(pool), team(team), capacity(HEADER_SIZE + bytesPerTeam) {
+        Kokkos::single(Kokkos::PerTeam(team), [&](uint8_t*& teamBlock) {
+            teamBlock = pool.tryAllocate(capacity);
+            assert(teamBlock && "The pool of a TeamArena must not need to grow inside a kernel");
+
+            if (teamBlock) {
+                *reinterpret_cast<size_t*>(teamBlock) = HEADER_SIZE;
+            }
+        }, block);
+    }
+
+    ~TeamArena() {
+        team.team_barrier(); // No thread of the team may still be using a sub-allocation
+
+        Kokkos::single(Kokkos::PerTeam(team), [&] {
+            if (block) {
+                pool.deallocate(block);
+            }
+        });
+    }
+
+    TeamArena(const TeamArena&) = delete;
+    TeamArena& operator=(const TeamArena&) = delete;
+
+    // Returns nullptr once the team's block is used up
+    uint8_t* allocate(size_t n) {
+        if (!block) {
+            return nullptr;
+        }
+
+        size_t size = (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        size_t offset = Kokkos::atomic_fetch_add(reinterpret_cast<size_t*>(block), size);
+
+        return offset + size <= capacity ? block + offset : nullptr;
+    }
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n) {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType))), n);
+    }
+
+    // Makes the whole block available again. Every thread of the team has to call this.
+    void reset() {
+        team.team_barrier();
+
+        Kokkos::single(Kokkos::PerTeam(team), [&] {
+            if (block) {
+                *reinterpret_cast<size_t*>(block) = HEADER_SIZE;
+            }
+        });
+
+        team.team_barrier();
+    }
+
+    size_t getCapacity() const { return capacity - HEADER_SIZE; }
+
+private:
+    Pool& pool;
+    const TeamMember& team;
+    size_t capacity; // Including the header
+    uint8_t* block = nullptr;
+};
+
+#endif //KOKKOS_MEMORY_POOL_TEAMARENA_HPP
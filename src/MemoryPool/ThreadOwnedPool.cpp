@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <mutex>
+
+#include "ThreadOwnedPool.hpp"
+
+namespace {
+// Pools are created and grown on whichever thread allocates, which need not be one Kokkos started
+PoolOptions getOwnedPoolOptions() {
+    PoolOptions options;
+    options.clearWithMemset = true;
+    return options;
+}
+}
+
+ThreadOwnedMultiPool::OwnedPool::OwnedPool(size_t initialChunks, ThreadOwnedMultiPool &parent)
+    : pool(std::in_place, initialChunks, getOwnedPoolOptions(), [&parent, this](HostMemoryPool& subPool) { parent.registerPool(subPool, this); }) {}
+
+void ThreadOwnedMultiPool::OwnedPool::pushRemoteFree(uint8_t *data) {
+    auto* node = reinterpret_cast<RemoteFree*>(data);
+    node->next = remoteFrees.load(std::memory_order_relaxed);
+
+    while (!remoteFrees.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+
+    numRemoteFrees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadOwnedMultiPool::OwnedPool::drainRemoteFrees(PoolStatistics& statistics) {
+    if (!remoteFrees.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // Taking the whole list at once means the owner never races producers on individual nodes
+    RemoteFree* node = remoteFrees.exchange(nullptr, std::memory_order_acquire);
+    unsigned numDrained = 0;
+
+    while (node) {
+        RemoteFree* next = node->next;
+        statistics.recordDeallocation(pool->getAllocationSize(reinterpret_cast<uint8_t*>(node)));
+        pool->deallocate(reinterpret_cast<uint8_t*>(node));
+        node = next;
+        numDrained++;
+    }
+
+    numRemoteFrees.fetch_sub(numDrained, std::memory_order_relaxed);
+}
+
+ThreadOwnedMultiPool::ThreadPools::~ThreadPools() {
+    // Publishes everything this thread did to its pools to whichever thread adopts them
+    for (const auto& [instanceId, ownedPool] : pools) {
+        ownedPool->exited.store(true, std::memory_order_release);
+    }
+}
+
+ThreadOwnedMultiPool::ThreadOwnedMultiPool(size_t initialChunksPerThread) : initialChunksPerThread(initialChunksPerThread) {
+    static std::atomic<uint64_t> nextInstanceId = 1;
+    instanceId = nextInstanceId.fetch_add(1, std::memory_order_relaxed);
+}
+
+ThreadOwnedMultiPool::~ThreadOwnedMultiPool() {
+    // Threads that used this pool may outlive it, holding on to their OwnedPool. They only keep the empty shell.
+    for (auto& ownedPool : pools) {
+        ownedPool->pool.reset();
+        ownedPool->released.store(true, std::memory_order_release);
+    }
+}
+
+void ThreadOwnedMultiPool::registerPool(HostMemoryPool &pool, OwnedPool *owner) {
+    ranges.add(pool.getBaseAddress(), pool.getBaseAddress() + pool.getSizeInBytes(), owner);
+}
+
+ThreadOwnedMultiPool::OwnedPool &ThreadOwnedMultiPool::getOwnPool() {
+    thread_local uint64_t cachedInstanceId = 0; // Instance ids start at 1
+    thread_local OwnedPool* cachedPool = nullptr;
+
+    if (cachedInstanceId != instanceId) {
+        cachedPool = &getOwnPoolSlow();
+        cachedInstanceId = instanceId;
+    }
+
+    return *cachedPool;
+}
+
+ThreadOwnedMultiPool::OwnedPool &ThreadOwnedMultiPool::getOwnPoolSlow() {
+    thread_local ThreadPools threadPools;
+    auto& ownedPools = threadPools.pools;
+
+    // Drop the shells of ThreadOwnedMultiPools destroyed since
+    ownedPools.erase(std::remove_if(ownedPools.begin(), ownedPools.end(), [](const auto& entry) {
+        return entry.second->released.load(std::memory_order_acquire);
+    }), ownedPools.end());
+
+    for (const auto& [ownerInstanceId, ownedPool] : ownedPools) {
+        if (ownerInstanceId == instanceId) {
+            return *ownedPool;
+        }
+    }
+
+    return *ownedPools.emplace_back(instanceId, adoptOrCreatePool()).second;
+}
+
+std::shared_ptr<ThreadOwnedMultiPool::OwnedPool> ThreadOwnedMultiPool::adoptOrCreatePool() {
+    {
+        std::unique_lock lock(poolsMutex);
+
+        for (const auto& ownedPool : pools) {
+            bool exited = true;
+            if (ownedPool->exited.compare_exchange_strong(exited, false, std::memory_order_acquire)) {
+                return ownedPool;
+            }
+        }
+    }
+
+    auto ownedPool = std::make_shared<OwnedPool>(initialChunksPerThread, *this);
+
+    std::unique_lock lock(poolsMutex);
+    return pools.emplace_back(std::move(ownedPool));
+}
+
+uint8_t *ThreadOwnedMultiPool::allocate(size_t n) {
+    auto& ownPool = getOwnPool();
+
+    ownPool.drainRemoteFrees(statistics);
+    statistics.recordAllocation(HostMemoryPool::getRequiredChunks(n));
+
+    return ownPool.pool->allocate(n);
+}
+
+void ThreadOwnedMultiPool::deallocate(uint8_t *data) {
+    auto& ownPool = getOwnPool();
+    OwnedPool* owner = ranges.find(data);
+
+    if (owner != &ownPool) {
+        owner->pushRemoteFree(data);
+        return;
+    }
+
+    ownPool.drainRemoteFrees(statistics);
+    statistics.recordDeallocation(ownPool.pool->getAllocationSize(data));
+    ownPool.pool->deallocate(data);
+}
+
+void ThreadOwnedMultiPool::drainRemoteFrees() {
+    getOwnPool().drainRemoteFrees(statistics);
+}
+
+unsigned ThreadOwnedMultiPool::getNumThreads() const {
+    std::shared_lock lock(poolsMutex);
+    return pools.size();
+}
+
+template<typename Func>
+unsigned ThreadOwnedMultiPool::sumOverThreads(Func func) const {
+    std::shared_lock lock(poolsMutex);
+    unsigned sum = 0;
+
+    for (const auto& ownedPool : pools) {
+        sum += func(*ownedPool);
+    }
+
+    return sum;
+}
+
+unsigned ThreadOwnedMultiPool::getNumPendingRemoteFrees() const {
+    return sumOverThreads([](const OwnedPool& ownedPool) { return ownedPool.numRemoteFrees.load(std::memory_order_relaxed); });
+}
+
+unsigned ThreadOwnedMultiPool::getNumAllocations() const {
+    return statistics.getNumAllocations();
+}
+
+unsigned ThreadOwnedMultiPool::getNumFreeChunks() const {
+    return sumOverThreads([](const OwnedPool& ownedPool) { return ownedPool.pool->getNumFreeChunks(); });
+}
+
+unsigned ThreadOwnedMultiPool::getNumAllocatedChunks() const {
+    return statistics.getNumAllocatedChunks();
+}
+
+unsigned ThreadOwnedMultiPool::getNumChunks() const {
+    return sumOverThreads([](const OwnedPool& ownedPool) { return ownedPool.pool->getNumChunks(); });
+}
+
+unsigned ThreadOwnedMultiPool::getNumFreeFragments() const {
+    return sumOverThreads([](const OwnedPool& ownedPool) { return ownedPool.pool->getNumFreeFragments(); });
+}
+
+std::ostream &operator<<(std::ostream &os, const ThreadOwnedMultiPool &pool) {
+    std::shared_lock lock(pool.poolsMutex);
+
+    for (size_t index = 0; index < pool.pools.size(); index++) {
+        os << "Pool " << index << ": " << *pool.pools[index]->pool << '\n';
+    }
+
+    return os;
+}
@@ -0,0 +1,107 @@
+#ifndef KOKKOS_MEMORY_POOL_THREADOWNEDPOOL_HPP
+#define KOKKOS_MEMORY_POOL_THREADOWNEDPOOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+#include "PoolRangeTable.hpp"
+#include "PoolStatistics.hpp"
+
+// Gives every thread its own HostMultiPool, which only that thread ever touches, so allocation takes no lock. Blocks
+// freed by any other thread are pushed onto a lock-free MPSC queue belonging to the owning pool, threaded through the
+// freed blocks themselves. The owner drains its queue as one batch at the start of its own allocate and deallocate
+// calls. Threads find their pool through a thread_local cache and the owner of a block through a PoolRangeTable, so
+// neither path touches a shared lock once a thread has its pool. When a thread exits, the next thread that uses the
+// pool for the first time adopts its pool, together with its memory and anything still queued for it. Pools are built
+// and grown with PoolOptions::clearWithMemset, since the allocating thread need not be one Kokkos started.
+class ThreadOwnedMultiPool {
+public:
+    explicit ThreadOwnedMultiPool(size_t initialChunksPerThread);
+    ~ThreadOwnedMultiPool();
+
+    ThreadOwnedMultiPool(const ThreadOwnedMultiPool&) = delete;
+    ThreadOwnedMultiPool& operator=(const ThreadOwnedMultiPool&) = delete;
+
+    uint8_t* allocate(size_t n);
+    void deallocate(uint8_t* data);
+    void drainRemoteFrees(); // Drains the queue of the calling thread's pool
+
+    template<typename DataType>
+    Kokkos::View<DataType*, Kokkos::HostSpace> allocateView(size_t n) {
+        return Kokkos::View<DataType*, Kokkos::HostSpace>(reinterpret_cast<DataType*>(allocate(n * sizeof(DataType))), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const ThreadOwnedMultiPool &pool);
+
+    unsigned getNumThreads() const; // Pools handed out so far, including pools of exited threads not adopted yet
+    unsigned getNumPendingRemoteFrees() const; // Blocks queued but not yet drained, still counted as allocated
+
+    // Lock free and safe to poll from any thread, see PoolStatistics for what a read observes
+    unsigned getNumAllocations() const;
+    unsigned getNumAllocatedChunks() const;
+
+    // These read pools owned by other threads and are only meaningful while no thread is using the pool
+    unsigned getNumFreeChunks() const;
+    unsigned getNumChunks() const;
+    unsigned getNumFreeFragments() const;
+
+private:
+    struct RemoteFree {
+        RemoteFree* next;
+    };
+
+    struct OwnedPool {
+        OwnedPool(size_t initialChunks, ThreadOwnedMultiPool& parent);
+
+        void pushRemoteFree(uint8_t* data);
+        void drainRemoteFrees(PoolStatistics& statistics);
+
+        std::optional<HostMultiPool> pool; // Emptied when the ThreadOwnedMultiPool is destroyed
+        std::atomic<bool> exited = false; // Its thread has exited, so another thread may adopt it
+        std::atomic<bool> released = false; // The ThreadOwnedMultiPool is gone
+
+        // Written by every other thread, kept off the cache lines the owner uses for its pool
+        alignas(64) std::atomic<RemoteFree*> remoteFrees = nullptr;
+        std::atomic<unsigned> numRemoteFrees = 0;
+    };
+
+    // The pools a thread holds, one per ThreadOwnedMultiPool it used. Destroyed on thread exit, which marks them exited.
+    struct ThreadPools {
+        ~ThreadPools();
+
+        std::vector<std::pair<uint64_t, std::shared_ptr<OwnedPool>>> pools; // By instance id
+    };
+
+    OwnedPool& getOwnPool();
+    OwnedPool& getOwnPoolSlow();
+    std::shared_ptr<OwnedPool> adoptOrCreatePool();
+    void registerPool(HostMemoryPool& pool, OwnedPool* owner);
+
+    template<typename Func>
+    unsigned sumOverThreads(Func func) const;
+
+    size_t initialChunksPerThread;
+    uint64_t instanceId; // Unlike the address, never reused, so stale thread_local entries cannot match
+
+    mutable std::shared_mutex poolsMutex;
+    std::vector<std::shared_ptr<OwnedPool>> pools;
+
+    PoolRangeTable<OwnedPool*> ranges;
+
+    PoolStatistics statistics;
+};
+
+#endif //KOKKOS_MEMORY_POOL_THREADOWNEDPOOL_HPP
@@ -0,0 +1,190 @@
+#ifndef KOKKOS_MEMORY_POOL_ZEROINGMULTIPOOL_HPP
+#define KOKKOS_MEMORY_POOL_ZEROINGMULTIPOOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "MemoryPool.hpp"
+
+// Clears memory with streaming stores so the zeroed lines do not evict the foreground threads' working set
+inline void zeroNonTemporal(uint8_t* data, size_t bytes) {
+#ifdef __SSE2__
+    constexpr size_t VECTOR_SIZE = sizeof(__m128i);
+
+    if (reinterpret_cast<uintptr_t>(data) % VECTOR_SIZE == 0 && bytes % VECTOR_SIZE == 0) {
+        const __m128i zero = _mm_setzero_si128();
+
+        for (size_t i = 0; i < bytes; i += VECTOR_SIZE) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(data + i), zero);
+        }
+
+        _mm_sfence();
+        return;
+    }
+#endif
+    std::memset(data, 0, bytes);
+}
+
+// Thread safe MultiPool with a worker thread that clears dirty free runs while the pool is idle, so allocateZeroed
+// rarely has anything left to clear. The worker only takes the lock with try_lock, and holds it while it picks a run,
+// which merges any held back frees and walks the dirty and free sets, and while it returns the run. The clearing
+// itself happens unlocked. An allocation that finds no room waits for a run being cleared to come back before
+// growing the pool, and the worker takes no new run while one is waiting.
+template<typename MemorySpace = Kokkos::HostSpace>
+class ZeroingMultiPool {
+public:
+    static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace, MemorySpace>::accessible, "The zeroing thread runs on the host");
+
+    static constexpr size_t MAX_RUN_CHUNKS = (2 * 1024 * 1024) / BasicMemoryPool<MemorySpace>::DEFAULT_CHUNK_SIZE;
+
+    explicit ZeroingMultiPool(size_t initialChunks, std::chrono::milliseconds idleInterval = std::chrono::milliseconds(10))
+            : pool(initialChunks), idleInterval(idleInterval), worker([this] { zeroFreeRuns(); }) {}
+
+    ~ZeroingMultiPool() {
+        {
+            std::lock_guard lock(signalMutex);
+            stopping = true;
+        }
+
+        signal.notify_one();
+        worker.join();
+    }
+
+    ZeroingMultiPool(const ZeroingMultiPool&) = delete;
+    ZeroingMultiPool& operator=(const ZeroingMultiPool&) = delete;
+
+    uint8_t* allocate(size_t n) {
+        return allocateFromPool(n, false);
+    }
+
+    uint8_t* allocateZeroed(size_t n) {
+        return allocateFromPool(n, true);
+    }
+
+    void deallocate(uint8_t* data) {
+        {
+            std::lock_guard lock(mutex);
+            pool.deallocate(data);
+        }
+
+        {
+            std::lock_guard lock(signalMutex);
+            pendingWork = true;
+        }
+
+        signal.notify_one();
+    }
+
+    template<typename DataType>
+    Kokkos::View<DataType*, MemorySpace> allocateView(size_t n, bool zeroed = false) {
+        uint8_t* ptr = zeroed ? allocateZeroed(n * sizeof(DataType)) : allocate(n * sizeof(DataType));
+        return Kokkos::View<DataType*, MemorySpace>(reinterpret_cast<DataType*>(ptr), n);
+    }
+
+    template<typename DataType, typename... Properties>
+    void deallocateView(Kokkos::View<DataType*, Properties...> view) {
+        deallocate(reinterpret_cast<uint8_t*>(view.data()));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const ZeroingMultiPool &zeroingPool) {
+        std::lock_guard lock(zeroingPool.mutex);
+        return os << zeroingPool.pool;
+    }
+
+    // A run being cleared is counted as neither free nor allocated
+    unsigned getNumAllocations() const { return withLock(&BasicMultiPool<MemorySpace>::getNumAllocations); }
+    unsigned getNumFreeChunks() const { return withLock(&BasicMultiPool<MemorySpace>::getNumFreeChunks); }
+    unsigned getNumAllocatedChunks() const { return withLock(&BasicMultiPool<MemorySpace>::getNumAllocatedChunks); }
+    unsigned getNumChunks() const { return withLock(&BasicMultiPool<MemorySpace>::getNumChunks); }
+    unsigned getNumFreeFragments() const { return withLock(&BasicMultiPool<MemorySpace>::getNumFreeFragments); }
+    unsigned getNumDirtyFreeChunks() const { return withLock(&BasicMultiPool<MemorySpace>::getNumDirtyFreeChunks); }
+
+private:
+    using DirtyRun = typename BasicMultiPool<MemorySpace>::DirtyRun;
+
+    unsigned withLock(unsigned (BasicMultiPool<MemorySpace>::*getter)() const) const {
+        std::lock_guard lock(mutex);
+        return (pool.*getter)();
+    }
+
+    uint8_t* allocateFromPool(size_t n, bool zeroed) {
+        std::unique_lock lock(mutex);
+        uint8_t* ptr = zeroed ? pool.tryAllocateZeroed(n) : pool.tryAllocate(n);
+
+        // The run being cleared may be exactly what would fit, and growing instead would keep the extra sub-pool for good
+        if (!ptr && clearing) {
+            numWaiting++;
+            runReturned.wait(lock, [this] { return !clearing; });
+            numWaiting--;
+
+            ptr = zeroed ? pool.tryAllocateZeroed(n) : pool.tryAllocate(n);
+        }
+
+        if (!ptr) {
+            ptr = zeroed ? pool.allocateZeroed(n) : pool.allocate(n);
+        }
+
+        return ptr;
+    }
+
+    void zeroFreeRuns() {
+        while (true) {
+            std::optional<DirtyRun> run;
+
+            {
+                std::unique_lock lock(mutex, std::try_to_lock);
+                if (lock.owns_lock() && !numWaiting) {
+                    run = pool.takeDirtyFreeRun(MAX_RUN_CHUNKS);
+                    clearing = run.has_value();
+                }
+            }
+
+            if (run) {
+                uint8_t* data = run->pool->getBaseAddress() + (run->indices.first * BasicMemoryPool<MemorySpace>::DEFAULT_CHUNK_SIZE);
+                zeroNonTemporal(data, (run->indices.second - run->indices.first) * BasicMemoryPool<MemorySpace>::DEFAULT_CHUNK_SIZE);
+
+                std::lock_guard lock(mutex);
+                pool.returnCleanRun(*run);
+                clearing = false;
+                runReturned.notify_all();
+                continue;
+            }
+
+            // Nothing to clear, or the foreground holds the lock. Sleep until something is freed or the interval passes.
+            std::unique_lock lock(signalMutex);
+            signal.wait_for(lock, idleInterval, [this] { return stopping || pendingWork; });
+
+            if (stopping) {
+                return;
+            }
+
+            pendingWork = false;
+        }
+    }
+
+    mutable std::mutex mutex;
+    BasicMultiPool<MemorySpace> pool;
+    std::condition_variable runReturned;
+    bool clearing = false; // Guarded by mutex, like numWaiting
+    unsigned numWaiting = 0;
+
+    std::mutex signalMutex;
+    std::condition_variable signal;
+    bool pendingWork = false;
+    bool stopping = false;
+    std::chrono::milliseconds idleInterval;
+
+    std::thread worker; // Declared last so it starts after everything it uses is constructed
+};
+
+#endif //KOKKOS_MEMORY_POOL_ZEROINGMULTIPOOL_HPP
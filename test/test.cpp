@@ -2,10 +2,28 @@
 // Created by Matthew McCall on 5/23/23.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
 #include <locale>
 #include <map>
+#include <memory_resource>
 #include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "catch2/catch_session.hpp"
 #include "catch2/catch_test_macros.hpp"
@@ -20,6 +38,18 @@
 #include "fmt/chrono.h"
 
 #include "MemoryPool/MemoryPool.hpp"
+#include "MemoryPool/BudgetedMultiPool.hpp"
+#include "MemoryPool/InstancePool.hpp"
+#include "MemoryPool/NumaPool.hpp"
+#include "MemoryPool/ObjectPool.hpp"
+#include "MemoryPool/PersistentPool.hpp"
+#include "MemoryPool/PoolResource.hpp"
+#include "MemoryPool/SegmentedArray.hpp"
+#include "MemoryPool/ShardedMultiPool.hpp"
+#include "MemoryPool/SharedMemoryPool.hpp"
+#include "MemoryPool/TeamArena.hpp"
+#include "MemoryPool/ThreadOwnedPool.hpp"
+#include "MemoryPool/ZeroingMultiPool.hpp"
 
 constexpr size_t TEST_POOL_SIZE = 4;
 
@@ -42,6 +72,48 @@ struct LargeStruct {
 
 static_assert(sizeof(LargeStruct) == MemoryPool::DEFAULT_CHUNK_SIZE * TEST_POOL_SIZE / 2);
 
+// Kokkos does not support launching kernels from threads it did not start. Threads that set kokkosLaunchesForbidden
+// have every kernel and deep copy they launch counted through the Kokkos Tools callbacks while a ForbiddenLaunchCounter
+// is alive.
+thread_local bool kokkosLaunchesForbidden = false;
+std::atomic<unsigned> numForbiddenKokkosLaunches = 0;
+
+class ForbiddenLaunchCounter {
+public:
+    ForbiddenLaunchCounter() {
+        numForbiddenKokkosLaunches = 0;
+        Kokkos::Tools::Experimental::set_begin_parallel_for_callback(countKernel);
+        Kokkos::Tools::Experimental::set_begin_parallel_reduce_callback(countKernel);
+        Kokkos::Tools::Experimental::set_begin_parallel_scan_callback(countKernel);
+        Kokkos::Tools::Experimental::set_begin_deep_copy_callback(countDeepCopy);
+    }
+
+    ~ForbiddenLaunchCounter() {
+        Kokkos::Tools::Experimental::set_begin_parallel_for_callback(nullptr);
+        Kokkos::Tools::Experimental::set_begin_parallel_reduce_callback(nullptr);
+        Kokkos::Tools::Experimental::set_begin_parallel_scan_callback(nullptr);
+        Kokkos::Tools::Experimental::set_begin_deep_copy_callback(nullptr);
+    }
+
+    ForbiddenLaunchCounter(const ForbiddenLaunchCounter&) = delete;
+    ForbiddenLaunchCounter& operator=(const ForbiddenLaunchCounter&) = delete;
+
+    unsigned getNumLaunches() const { return numForbiddenKokkosLaunches; }
+
+private:
+    static void countKernel(const char*, uint32_t, uint64_t*) {
+        if (kokkosLaunchesForbidden) {
+            numForbiddenKokkosLaunches++;
+        }
+    }
+
+    static void countDeepCopy(Kokkos::Tools::SpaceHandle, const char*, const void*, Kokkos::Tools::SpaceHandle, const char*, const void*, uint64_t) {
+        if (kokkosLaunchesForbidden) {
+            numForbiddenKokkosLaunches++;
+        }
+    }
+};
+
 class TestControl : public Catch::EventListenerBase {
 public:
     using EventListenerBase::EventListenerBase;
@@ -311,122 +383,1653 @@ TEST_CASE("Pool works under fragmentation", "[MemoryPool][allocation][deallocati
     CAPTURE(pool);
 }
 
-TEST_CASE("Benchmarks", "[!benchmark]") {
-    constexpr size_t NUMBER_OF_VIEWS = 100'000;
-    constexpr size_t SIZE_OF_VIEWS = 1024;
+TEST_CASE("MultiPoolResource serves standard containers", "[MultiPoolResource][allocation][deallocation]") {
+    HostMultiPool pool(TEST_POOL_SIZE); // 512 bytes
+    MultiPoolResource resource(pool);
 
-    const size_t TOTAL_CHUNK_SIZE = MemoryPool::getRequiredChunks(sizeof(int) * SIZE_OF_VIEWS) * NUMBER_OF_VIEWS;
+    SECTION("pmr vector allocates from and returns memory to the pool") {
+        {
+            std::pmr::vector<int> vec(&resource);
+            vec.resize(16);
+            CAPTURE(pool);
+            EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(int[16]), 1);
+        }
 
-    std::locale loc("en_US.UTF-8"); // For thousands separator
+        CAPTURE(pool);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
 
-    BENCHMARK(fmt::format(loc, "Kokkos Allocating {:L} Views of {:L} ints", NUMBER_OF_VIEWS, SIZE_OF_VIEWS)) {
-        std::vector<Kokkos::View<int[SIZE_OF_VIEWS]>> views(NUMBER_OF_VIEWS);
+    SECTION("pmr unordered_map grows the pool when needed") {
+        {
+            std::pmr::unordered_map<int, int> map(&resource);
+            for (int i = 0; i < 100; i++) {
+                map[i] = i;
+            }
 
-        for (auto &view: views) {
-            view = Kokkos::View<int[SIZE_OF_VIEWS]>("view", SIZE_OF_VIEWS);
-            REQUIRE(view.size() == SIZE_OF_VIEWS);
+            REQUIRE(map.size() == 100);
+            REQUIRE(pool.getNumAllocations() > 0);
         }
 
-        return views.size();
-    };
+        CAPTURE(pool);
+        REQUIRE(pool.getNumAllocations() == 0);
+    }
 
-    BENCHMARK(fmt::format(loc, "MultiPool Allocation {:L} Views of {:L} ints", NUMBER_OF_VIEWS, SIZE_OF_VIEWS)) {
-        MultiPool pool(TOTAL_CHUNK_SIZE);
-        std::vector<Kokkos::View<int[SIZE_OF_VIEWS]>> views(NUMBER_OF_VIEWS);
+    SECTION("Over-aligned requests are honored") {
+        constexpr size_t ALIGNMENT = MemoryPool::DEFAULT_CHUNK_SIZE * 2;
 
-        for (auto &view: views) {
-            view = pool.allocateView<int>(SIZE_OF_VIEWS);
-            REQUIRE(view.size() == SIZE_OF_VIEWS);
+        void* first = resource.allocate(1, ALIGNMENT);
+        void* second = resource.allocate(1, ALIGNMENT);
+        REQUIRE(reinterpret_cast<uintptr_t>(first) % ALIGNMENT == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(second) % ALIGNMENT == 0);
+
+        resource.deallocate(first, 1, ALIGNMENT);
+        resource.deallocate(second, 1, ALIGNMENT);
+        CAPTURE(pool);
+        REQUIRE(pool.getNumAllocations() == 0);
+    }
+
+    SECTION("PoolAllocator works with non-pmr containers") {
+        {
+            std::vector<int, PoolAllocator<int>> vec(PoolAllocator<int>{resource});
+            vec.resize(16);
+            CAPTURE(pool);
+            EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(int[16]), 1);
+            REQUIRE(vec.get_allocator() == PoolAllocator<double>{resource});
         }
 
-        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, TOTAL_CHUNK_SIZE, NUMBER_OF_VIEWS);
-        return views.size();
-    };
+        CAPTURE(pool);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
 }
 
-TEST_CASE("Fragmentation Benchmarks", "[!benchmark][fragmentation]") {
-    constexpr size_t NUMBER_OF_VIEWS = 10'000;
-    constexpr size_t SIZE_OF_VIEWS = 1024;
-    const size_t INITIAL_CHUNKS_PER_VIEW = MemoryPool::getRequiredChunks(sizeof(int) * SIZE_OF_VIEWS);
+TEST_CASE("Pools in different memory spaces hand out views in their own space", "[MemoryPool][allocation][spaces]") {
+    HostMultiPool hostPool(TEST_POOL_SIZE);
+    MultiPool defaultPool(TEST_POOL_SIZE);
 
-    const size_t TOTAL_CHUNK_SIZE = INITIAL_CHUNKS_PER_VIEW * NUMBER_OF_VIEWS;
+    auto hostView = hostPool.allocateView<int>(4);
+    auto defaultView = defaultPool.allocateView<int>(4);
 
-    std::locale loc("en_US.UTF-8"); // For thousands separator
+    static_assert(std::is_same_v<decltype(hostView)::memory_space, Kokkos::HostSpace>);
+    static_assert(std::is_same_v<decltype(defaultView)::memory_space, Kokkos::DefaultExecutionSpace::memory_space>);
 
-    int deallocStep = GENERATE(range(2, 5));
-    int reallocFill = GENERATE_COPY(range(1, deallocStep));
+    for (size_t i = 0; i < hostView.size(); i++) {
+        hostView(i) = static_cast<int>(i);
+    }
 
-    std::string kokkosBenchmarkName = fmt::format(loc, "Kokkos Allocation of {:L} Views of {:L} ints with {:L} free chunks between allocations and {:L} chunks requested in following allocations", NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW);
+    REQUIRE(hostView(3) == 3);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(hostPool, 1, 1);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(defaultPool, 1, 1);
 
-    SECTION(kokkosBenchmarkName) {
-        // CSV output
-        INFO(fmt::format("csvKokkos,{},{},{},{}", NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW));
+    hostPool.deallocateView(hostView);
+    defaultPool.deallocateView(defaultView);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(hostPool, 0, 0);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(defaultPool, 0, 0);
+}
 
-        BENCHMARK(std::move(kokkosBenchmarkName)) {
-            std::vector<Kokkos::View<int *>> views(NUMBER_OF_VIEWS);
+TEST_CASE("NUMA pool serves allocations from the requested node", "[NumaMultiPool][allocation][deallocation]") {
+    NumaMultiPool pool(TEST_POOL_SIZE);
+    CAPTURE(pool);
+    REQUIRE(pool.getNumNodes() >= 1);
+    REQUIRE(pool.getNodeIds() == getNumaNodeIds());
+    REQUIRE(std::is_sorted(pool.getNodeIds().begin(), pool.getNodeIds().end()));
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * pool.getNumNodes());
 
-            for (auto &view: views) {
-                view = Kokkos::View<int *>("view", SIZE_OF_VIEWS);
-                REQUIRE(view.size() == SIZE_OF_VIEWS);
-            }
+    const unsigned firstNode = pool.getNodeIds().front();
+    std::vector<Kokkos::View<int*, Kokkos::HostSpace>> views;
 
-            for (unsigned i = 0; i < views.size(); i++) {
-                if (i % deallocStep != 0) {
-                    CAPTURE(i);
-                    CAPTURE(deallocStep);
-                    CAPTURE(reallocFill);
-                    views[i] = Kokkos::View<int *>("view", SIZE_OF_VIEWS * reallocFill);
-                    REQUIRE(views[i].size() == SIZE_OF_VIEWS * reallocFill);
-                }
-            }
+    for (unsigned node : pool.getNodeIds()) {
+        views.push_back(pool.allocateView<int>(1, node));
+        REQUIRE(pool.getNodeOf(reinterpret_cast<uint8_t*>(views.back().data())) == node);
+    }
 
-            return views.size();
-        };
+    // Unbound, the scheduler may move this thread to another node between allocating and checking
+    NumaNodeBinding binding(firstNode);
+    REQUIRE((binding.isBound() || pool.getNumNodes() == 1));
+
+    auto localView = pool.allocateView<int>(1);
+    REQUIRE(pool.getNodeOf(reinterpret_cast<uint8_t*>(localView.data())) == (pool.getNumNodes() == 1 ? firstNode : getCurrentNumaNode()));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (pool.getNumNodes() + 1), (pool.getNumNodes() + 1));
+
+    SECTION("Growing a node's pool keeps its allocations on that node") {
+        auto largeView = pool.allocateView<VeryLargeStruct>(1, firstNode);
+        REQUIRE(pool.getNodeOf(reinterpret_cast<uint8_t*>(largeView.data())) == firstNode);
+        pool.deallocateView(largeView);
     }
 
-    std::string multiPoolBenchmarkName = fmt::format(loc, "Fragmented MultiPool Allocation of {:L} Views of {:L} ints with {:L} free chunks between allocations and {:L} chunks requested in following allocations", NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW);
+    SECTION("Nodes that are not online are served by the first online node") {
+        auto offlineView = pool.allocateView<int>(1, pool.getNodeIds().back() + 1);
+        REQUIRE(pool.getNodeOf(reinterpret_cast<uint8_t*>(offlineView.data())) == firstNode);
+        pool.deallocateView(offlineView);
+    }
 
-    SECTION(multiPoolBenchmarkName) {
-        // CSV output
-        INFO(fmt::format("csvMultiPool,{},{},{},{}", NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW));
+    for (auto& view : views) {
+        pool.deallocateView(view);
+    }
 
-        BENCHMARK(std::move(multiPoolBenchmarkName)) {
-            MultiPool pool(TOTAL_CHUNK_SIZE);
-            std::vector<Kokkos::View<int *>> views(NUMBER_OF_VIEWS);
+    pool.deallocateView(localView);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
 
-            for (auto &view: views) {
-                view = pool.allocateView<int>(SIZE_OF_VIEWS);
-                REQUIRE(view.size() == SIZE_OF_VIEWS);
-            }
+TEST_CASE("Shared memory pool shares allocations between mappings by offset", "[SharedMemoryPool][allocation][deallocation]") {
+    const std::string name = "/kokkos_memory_pool_test_" + std::to_string(getpid());
+    SharedMemoryPool::remove(name);
 
-            EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, TOTAL_CHUNK_SIZE, NUMBER_OF_VIEWS);
+    SharedMemoryPool pool(name, TEST_POOL_SIZE);
+    SharedMemoryPool attached(name);
+    REQUIRE(attached.getNumChunks() == TEST_POOL_SIZE);
 
-            for (unsigned i = 0; i < views.size(); i++) {
-                if (i % deallocStep != 0) {
-                    CAPTURE(i);
-                    CAPTURE(deallocStep);
-                    pool.deallocateView<int>(views[i]);
-                    unsigned expectedChunks =
-                            (((i / deallocStep) * (deallocStep - 1)) + (i % deallocStep)) * INITIAL_CHUNKS_PER_VIEW;
-                    REQUIRE(pool.getNumFreeChunks() == expectedChunks);
-                }
-            }
+    size_t offset = pool.allocate(sizeof(int) * 4);
+    REQUIRE(offset != SharedMemoryPool::INVALID_OFFSET);
+    CAPTURE(pool);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(attached, 1, 1);
 
-            REQUIRE(pool.getNumFreeChunks() ==
-                    static_cast<int>(NUMBER_OF_VIEWS * (static_cast<float>(deallocStep - 1) / deallocStep)) *
-                    INITIAL_CHUNKS_PER_VIEW);
+    auto view = pool.viewAt<int>(offset, 4);
+    for (int i = 0; i < 4; i++) {
+        view(i) = i * i;
+    }
 
-            for (unsigned i = 0; i < views.size(); i++) {
-                if (i % deallocStep != 0) {
-                    CAPTURE(i);
-                    CAPTURE(deallocStep);
-                    CAPTURE(reallocFill);
-                    views[i] = pool.allocateView<int>(SIZE_OF_VIEWS * reallocFill);
-                    REQUIRE(views[i].size() == SIZE_OF_VIEWS * reallocFill);
-                }
-            }
+    auto attachedView = attached.viewAt<int>(offset, 4);
+    REQUIRE(attachedView.data() != view.data());
+    REQUIRE(attachedView(3) == 9);
 
-            return views.size();
-        };
+    SECTION("Allocations from either mapping come from the same chunks") {
+        auto largeView = attached.allocateView<LargeStruct>(1);
+        REQUIRE(largeView.size() == 1);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (1 + EXPECTED_CHUNKS(LargeStruct)), 2);
+
+        REQUIRE(pool.allocate(sizeof(LargeStruct)) == SharedMemoryPool::INVALID_OFFSET);
+
+        attached.deallocateView(largeView);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 1, 1);
+    }
+
+    attached.deallocate(offset);
+    CAPTURE(pool);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    REQUIRE(pool.getNumFreeFragments() == 1);
+
+    SharedMemoryPool::remove(name);
+}
+
+TEST_CASE("Attaching to a shared memory segment that is never formatted times out", "[SharedMemoryPool]") {
+    const std::string name = "/kokkos_memory_pool_test_unformatted_" + std::to_string(getpid());
+    SharedMemoryPool::remove(name);
+
+    // Stands in for a creating process that died before formatting
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    REQUIRE(fd != -1);
+
+    SECTION("Never sized") {}
+
+    SECTION("Sized but never formatted") {
+        REQUIRE(ftruncate(fd, OffsetPool::getRequiredBytes(TEST_POOL_SIZE)) == 0);
+    }
+
+    close(fd);
+
+    REQUIRE_THROWS_AS(SharedMemoryPool(name, std::chrono::milliseconds(20)), std::runtime_error);
+    REQUIRE_THROWS_AS(SharedMemoryPool(name, TEST_POOL_SIZE, std::chrono::milliseconds(20)), std::runtime_error);
+
+    SharedMemoryPool::remove(name);
+}
+
+TEST_CASE("Persistent pool restores allocations when reopened", "[PersistentPool][allocation][deallocation]") {
+    const std::string path = (std::filesystem::temp_directory_path() / ("kokkos_memory_pool_test_" + std::to_string(getpid()))).string();
+    std::filesystem::remove(path);
+
+    size_t offset;
+
+    {
+        PersistentPool pool(path, TEST_POOL_SIZE);
+        REQUIRE_FALSE(pool.wasReopened());
+
+        auto view = pool.allocateView<int>(4);
+        REQUIRE(view.size() == 4);
+        for (int i = 0; i < 4; i++) {
+            view(i) = i + 1;
+        }
+
+        offset = pool.getOffset(reinterpret_cast<uint8_t*>(view.data()));
+        pool.setRoot(0, offset);
+        pool.flush();
+    }
+
+    {
+        PersistentPool pool(path, TEST_POOL_SIZE);
+        CAPTURE(pool);
+        REQUIRE(pool.wasReopened());
+        REQUIRE(pool.getRoot(0) == offset);
+        REQUIRE(pool.getRoot(1) == PersistentPool::INVALID_OFFSET);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 1, 1);
+
+        auto view = pool.viewAt<int>(pool.getRoot(0), 4);
+        REQUIRE(view(0) == 1);
+        REQUIRE(view(3) == 4);
+
+        REQUIRE(pool.allocate(sizeof(int)) != offset);
+
+        pool.deallocateView(view);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 1, 1);
+    }
+
+    REQUIRE_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    SECTION("Reopening a truncated file throws") {
+        std::filesystem::resize_file(path, OffsetPool::getRequiredBytes(TEST_POOL_SIZE) - OffsetPool::CHUNK_SIZE);
+        REQUIRE_THROWS_AS(PersistentPool(path, TEST_POOL_SIZE), std::runtime_error);
+    }
+
+    SECTION("Reopening a file that holds no pool throws") {
+        std::ofstream(path, std::ios::trunc) << "Not a pool";
+        REQUIRE_THROWS_AS(PersistentPool(path, TEST_POOL_SIZE), std::runtime_error);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("MultiPool snapshots restore allocations and their contents", "[MultiPool][snapshot]") {
+    const std::string path = (std::filesystem::temp_directory_path() / ("kokkos_memory_pool_snapshot_" + std::to_string(getpid()))).string();
+
+    HostMultiPool pool(TEST_POOL_SIZE); // 512 bytes
+
+    auto first = pool.allocateView<int>(4);
+    auto gap = pool.allocateView<int>(4);
+    auto second = pool.allocateView<VeryLargeStruct>(1); // Forces a second sub-pool
+
+    for (int i = 0; i < 4; i++) {
+        first(i) = i + 10;
+    }
+    second(0).data[MemoryPool::DEFAULT_CHUNK_SIZE] = 42;
+
+    pool.deallocateView(gap);
+
+    std::stringstream layoutBeforeSnapshot;
+    layoutBeforeSnapshot << pool;
+
+    pool.snapshot(path, 2);
+
+    first(0) = -1;
+    second(0).data[MemoryPool::DEFAULT_CHUNK_SIZE] = 0;
+
+    auto restoredAddresses = pool.restore(path, 2);
+    CAPTURE(pool);
+    REQUIRE(restoredAddresses.size() == 2);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (1 + EXPECTED_CHUNKS(VeryLargeStruct)), 2);
+
+    std::stringstream layoutAfterRestore;
+    layoutAfterRestore << pool;
+    REQUIRE(layoutAfterRestore.str() == layoutBeforeSnapshot.str());
+
+    auto* restoredFirst = reinterpret_cast<int*>(restoredAddresses.at(reinterpret_cast<uint8_t*>(first.data())));
+    auto* restoredSecond = reinterpret_cast<VeryLargeStruct*>(restoredAddresses.at(reinterpret_cast<uint8_t*>(second.data())));
+    REQUIRE(restoredFirst[0] == 10);
+    REQUIRE(restoredFirst[3] == 13);
+    REQUIRE(restoredSecond->data[MemoryPool::DEFAULT_CHUNK_SIZE] == 42);
+
+    pool.deallocate(reinterpret_cast<uint8_t*>(restoredFirst));
+    pool.deallocate(reinterpret_cast<uint8_t*>(restoredSecond));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("MultiPool snapshots leave out pending deallocations", "[MultiPool][snapshot][async]") {
+    const std::string path = (std::filesystem::temp_directory_path() / ("kokkos_memory_pool_snapshot_pending_" + std::to_string(getpid()))).string();
+
+    HostMultiPool pool(TEST_POOL_SIZE);
+    Kokkos::DefaultHostExecutionSpace instance;
+
+    auto kept = pool.allocateView<int>(4);
+    auto pending = pool.allocateView<int>(4);
+    kept(0) = 7;
+
+    pool.deallocateViewAsync(pending, instance);
+    REQUIRE(pool.getNumPendingDeallocations() == 1);
+
+    pool.snapshot(path, 2);
+    REQUIRE(pool.getNumPendingDeallocations() == 0);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 1, 1);
+
+    auto restoredAddresses = pool.restore(path, 2);
+    CAPTURE(pool);
+    REQUIRE(restoredAddresses.size() == 1);
+    REQUIRE(restoredAddresses.count(reinterpret_cast<uint8_t*>(pending.data())) == 0);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 1, 1);
+
+    auto* restoredKept = reinterpret_cast<int*>(restoredAddresses.at(reinterpret_cast<uint8_t*>(kept.data())));
+    REQUIRE(restoredKept[0] == 7);
+
+    pool.deallocate(reinterpret_cast<uint8_t*>(restoredKept));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("MultiPool restores that fail leave the pool untouched", "[MultiPool][snapshot]") {
+    const std::string path = (std::filesystem::temp_directory_path() / ("kokkos_memory_pool_snapshot_failed_" + std::to_string(getpid()))).string();
+
+    HostMultiPool pool(TEST_POOL_SIZE);
+
+    auto saved = pool.allocateView<int>(4);
+    pool.snapshot(path, 2);
+
+    auto live = pool.allocateView<int>(4);
+    live(0) = 3;
+
+    std::stringstream layoutBeforeRestore;
+    layoutBeforeRestore << pool;
+
+    SECTION("Truncated data") {
+        std::filesystem::resize_file(path, 4096); // Keeps the metadata, drops the allocated runs
+        REQUIRE_THROWS_AS(pool.restore(path, 2), std::system_error);
+    }
+
+    SECTION("Not a snapshot") {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a snapshot";
+        REQUIRE_THROWS_AS(pool.restore(path, 2), std::runtime_error);
+    }
+
+    std::stringstream layoutAfterRestore;
+    layoutAfterRestore << pool;
+    REQUIRE(layoutAfterRestore.str() == layoutBeforeRestore.str());
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 2, 2);
+    REQUIRE(live(0) == 3);
+
+    pool.deallocateView(saved);
+    pool.deallocateView(live);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Object pool constructs and recycles fixed size objects", "[ObjectPool][allocation][deallocation]") {
+    struct Particle {
+        double position[3];
+        int id;
+
+        explicit Particle(int id) : position{0, 0, 0}, id(id) {}
+    };
+
+    constexpr size_t OBJECTS_PER_BLOCK = 4;
+
+    HostMultiPool pool(TEST_POOL_SIZE);
+    ObjectPool<Particle> objects(pool, OBJECTS_PER_BLOCK);
+    REQUIRE(objects.getSlotSize() == sizeof(Particle));
+
+    std::vector<Particle*> particles;
+    for (int i = 0; i < 5; i++) {
+        particles.push_back(objects.construct(i));
+    }
+
+    REQUIRE(objects.getNumObjects() == 5);
+    REQUIRE(objects.getNumBlocks() == 2);
+    REQUIRE(objects.getNumFreeSlots() == (2 * OBJECTS_PER_BLOCK) - 5);
+    REQUIRE(particles[1] == particles[0] + 1);
+    REQUIRE(particles[4]->id == 4);
+    REQUIRE(pool.getNumAllocations() == 2);
+
+    SECTION("Destroyed slots are reused first") {
+        objects.destroy(particles[2]);
+        REQUIRE(objects.getNumObjects() == 4);
+
+        Particle* reused = objects.construct(7);
+        REQUIRE(reused == particles[2]);
+        REQUIRE(reused->id == 7);
+        REQUIRE(objects.getNumBlocks() == 2);
+    }
+
+    SECTION("Blocks are returned to the pool with the object pool") {
+        {
+            ObjectPool<Particle> scopedObjects(pool, OBJECTS_PER_BLOCK);
+            scopedObjects.construct(8);
+            REQUIRE(pool.getNumAllocations() == 3);
+        }
+
+        REQUIRE(pool.getNumAllocations() == 2);
+    }
+
+    SECTION("Blocks without room for an object are rejected") {
+        REQUIRE_THROWS_AS(ObjectPool<Particle>(pool, 0), std::invalid_argument);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Zeroed allocations only clear chunks that were used before", "[MemoryPool][allocation][zero]") {
+    HostMultiPool pool(TEST_POOL_SIZE); // 512 bytes
+    constexpr size_t INTS_PER_CHUNK = MemoryPool::DEFAULT_CHUNK_SIZE / sizeof(int);
+
+    REQUIRE(pool.getNumDirtyFreeChunks() == 0);
+
+    auto view = pool.allocateView<int>(INTS_PER_CHUNK * 2);
+    for (size_t i = 0; i < view.size(); i++) {
+        view(i) = 1;
+    }
+
+    pool.deallocateView(view);
+    CAPTURE(pool);
+    REQUIRE(pool.getNumDirtyFreeChunks() == 2);
+
+    SECTION("Zeroed allocation over dirty chunks is cleared") {
+        auto zeroed = pool.allocateView<int>(INTS_PER_CHUNK * 3, true);
+        REQUIRE(zeroed.data() == view.data());
+
+        for (size_t i = 0; i < zeroed.size(); i++) {
+            REQUIRE(zeroed(i) == 0);
+        }
+
+        pool.deallocateView(zeroed);
+        REQUIRE(pool.getNumDirtyFreeChunks() == 3);
+    }
+
+    SECTION("Plain allocation leaves previous contents") {
+        auto reused = pool.allocateView<int>(INTS_PER_CHUNK);
+        REQUIRE(reused(0) == 1);
+        pool.deallocateView(reused);
+        REQUIRE(pool.getNumDirtyFreeChunks() == 2);
+    }
+
+    SECTION("Purging free chunks never loses track of dirty memory") {
+        constexpr size_t PURGE_TEST_POOL_SIZE = 256; // Spans several pages
+
+        HostMultiPool largePool(PURGE_TEST_POOL_SIZE);
+        auto largeView = largePool.allocateView<int>(INTS_PER_CHUNK * PURGE_TEST_POOL_SIZE);
+        for (size_t i = 0; i < largeView.size(); i++) {
+            largeView(i) = 1;
+        }
+
+        largePool.deallocateView(largeView);
+        size_t purged = largePool.purgeFreeChunks();
+        REQUIRE(largePool.getNumDirtyFreeChunks() + purged == PURGE_TEST_POOL_SIZE);
+
+        auto zeroed = largePool.allocateView<int>(INTS_PER_CHUNK * PURGE_TEST_POOL_SIZE, true);
+        for (size_t i = 0; i < zeroed.size(); i++) {
+            REQUIRE(zeroed(i) == 0);
+        }
+    }
+}
+
+TEST_CASE("Background zeroing clears freed memory", "[ZeroingMultiPool][allocation][zero]") {
+    constexpr size_t INTS_PER_CHUNK = MemoryPool::DEFAULT_CHUNK_SIZE / sizeof(int);
+
+    ZeroingMultiPool<> pool(TEST_POOL_SIZE, std::chrono::milliseconds(1));
+
+    auto view = pool.allocateView<int>(INTS_PER_CHUNK * TEST_POOL_SIZE);
+    for (size_t i = 0; i < view.size(); i++) {
+        view(i) = 1;
+    }
+
+    pool.deallocateView(view);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (pool.getNumDirtyFreeChunks() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    CAPTURE(pool);
+    REQUIRE(pool.getNumDirtyFreeChunks() == 0);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    REQUIRE(pool.getNumFreeFragments() == 1);
+
+    // Nothing is dirty any more, so this does not have to clear anything itself
+    auto zeroed = pool.allocateView<int>(INTS_PER_CHUNK * TEST_POOL_SIZE, true);
+    for (size_t i = 0; i < zeroed.size(); i++) {
+        REQUIRE(zeroed(i) == 0);
+    }
+
+    pool.deallocateView(zeroed);
+
+    // Taking everything right after freeing it has to wait for a run being cleared rather than grow the pool
+    for (int i = 0; i < 100; i++) {
+        auto whole = pool.allocateView<int>(INTS_PER_CHUNK * TEST_POOL_SIZE);
+        whole(0) = 1;
+        pool.deallocateView(whole);
+    }
+
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE);
+}
+
+TEST_CASE("MultiPool grows in the background before running out", "[MultiPool][allocation][growth]") {
+    HostMultiPool pool(TEST_POOL_SIZE);
+    pool.setLowWaterMark(0.5);
+
+    auto small = pool.allocateView<LargeStruct>(1);
+    REQUIRE_FALSE(pool.isGrowing()); // Exactly half is still free
+
+    auto medium = pool.allocateView<int>(1);
+    REQUIRE(pool.isGrowing());
+
+    pool.waitForGrowth();
+    REQUIRE_FALSE(pool.isGrowing());
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * 3);
+
+    // Fits in the sub-pool grown ahead of time, so no pool is added synchronously
+    auto large = pool.allocateView<VeryLargeStruct>(1);
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * 3);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (EXPECTED_CHUNKS(LargeStruct) + 1 + EXPECTED_CHUNKS(VeryLargeStruct)), 3);
+
+    pool.deallocateView(small);
+    pool.deallocateView(medium);
+    pool.deallocateView(large);
+
+    pool.waitForGrowth();
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Asynchronous deallocations are released by fences", "[MultiPool][allocation][deallocation][async]") {
+    Kokkos::DefaultHostExecutionSpace instance;
+    HostMultiPool pool(TEST_POOL_SIZE);
+
+    auto view = pool.allocateView<LargeStruct>(1, instance);
+    Kokkos::parallel_for(Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(instance, 0, 1), KOKKOS_LAMBDA(int) {
+        view(0).data[0] = 1;
+    });
+
+    pool.deallocateViewAsync(view, instance);
+    REQUIRE(pool.getNumPendingDeallocations() == 1);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(LargeStruct), 1);
+
+    SECTION("The same instance reuses the block without a fence") {
+        auto reused = pool.allocateView<int>(1, instance);
+        REQUIRE(reinterpret_cast<uint8_t*>(reused.data()) == reinterpret_cast<uint8_t*>(view.data()));
+
+        // The rest of the block is split off and stays pending, since it may still be in use
+        REQUIRE(pool.getNumPendingDeallocations() == 1);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(LargeStruct), 2);
+
+        pool.deallocateView(reused);
+        pool.fence(instance);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
+
+    SECTION("Fencing the instance returns the block to the free sets") {
+        pool.fence(instance);
+        REQUIRE(pool.getNumPendingDeallocations() == 0);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
+
+    SECTION("A global fence releases every instance") {
+        pool.fence();
+        REQUIRE(pool.getNumPendingDeallocations() == 0);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
+}
+
+TEST_CASE("Instance pool keeps partitions apart until memory runs short", "[InstanceMultiPool][allocation][deallocation]") {
+    auto instances = Kokkos::Experimental::partition_space(Kokkos::DefaultHostExecutionSpace(), 1, 1);
+    InstanceMultiPool pool(instances, TEST_POOL_SIZE, TEST_POOL_SIZE);
+
+    REQUIRE(pool.getNumInstances() == 2);
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * 2);
+
+    auto first = pool.allocateView<LargeStruct>(1, instances[0]);
+    auto second = pool.allocateView<LargeStruct>(1, instances[1]);
+    REQUIRE(pool.getInstanceOf(reinterpret_cast<uint8_t*>(first.data())) == 0);
+    REQUIRE(pool.getInstanceOf(reinterpret_cast<uint8_t*>(second.data())) == 1);
+
+    auto third = pool.allocateView<LargeStruct>(1, instances[0]);
+    REQUIRE(pool.getInstanceOf(reinterpret_cast<uint8_t*>(third.data())) == 0);
+
+    // The first instance is full and at its limit, so this is borrowed from the second instead of growing
+    auto borrowed = pool.allocateView<LargeStruct>(1, instances[0]);
+    REQUIRE(pool.getInstanceOf(reinterpret_cast<uint8_t*>(borrowed.data())) == 1);
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * 2);
+
+    // Nobody has room left, so the caller's instance grows
+    auto grown = pool.allocateView<LargeStruct>(1, instances[0]);
+    REQUIRE(pool.getInstanceOf(reinterpret_cast<uint8_t*>(grown.data())) == 0);
+    REQUIRE(pool.getNumChunks(0) > TEST_POOL_SIZE);
+    REQUIRE(pool.getNumChunks(1) == TEST_POOL_SIZE);
+
+    for (auto* data : {first.data(), second.data(), third.data(), borrowed.data(), grown.data()}) {
+        pool.deallocate(reinterpret_cast<uint8_t*>(data));
+    }
+
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+
+    SECTION("Instances with the same id share one pool") {
+        InstanceMultiPool sharedPool(std::vector{instances[0], instances[1], instances[0]}, TEST_POOL_SIZE);
+        REQUIRE(sharedPool.getNumInstances() == 2);
+        REQUIRE(sharedPool.getNumChunks() == TEST_POOL_SIZE * 2);
+
+        auto view = sharedPool.allocateView<int>(1, instances[0]);
+        REQUIRE(sharedPool.getInstanceOf(reinterpret_cast<uint8_t*>(view.data())) == 0);
+
+        sharedPool.deallocateView(view);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(sharedPool, 0, 0);
+    }
+}
+
+TEST_CASE("Thread owned pools queue frees from other threads", "[ThreadOwnedMultiPool][allocation][deallocation]") {
+    ThreadOwnedMultiPool pool(TEST_POOL_SIZE);
+
+    auto view = pool.allocateView<LargeStruct>(1);
+    REQUIRE(pool.getNumThreads() == 1);
+
+    std::thread consumer([&pool, view] {
+        pool.deallocateView(view);
+    });
+    consumer.join();
+
+    // The consumer got a pool of its own, but the block went back to the producer's queue
+    REQUIRE(pool.getNumThreads() == 2);
+    REQUIRE(pool.getNumPendingRemoteFrees() == 1);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(LargeStruct), 1);
+
+    // The owner drains its queue before serving the next allocation from the same block
+    auto reused = pool.allocateView<VeryLargeStruct>(1);
+    REQUIRE(pool.getNumPendingRemoteFrees() == 0);
+    REQUIRE(reinterpret_cast<uint8_t*>(reused.data()) == reinterpret_cast<uint8_t*>(view.data()));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(VeryLargeStruct), 1);
+
+    pool.deallocateView(reused);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+
+    // The consumer has exited, so the next new thread takes over its pool instead of getting another one
+    auto adopted = pool.allocateView<LargeStruct>(1);
+
+    std::thread successor([&pool, adopted] {
+        pool.deallocateView(adopted);
+    });
+    successor.join();
+
+    REQUIRE(pool.getNumThreads() == 2);
+    REQUIRE(pool.getNumPendingRemoteFrees() == 1);
+
+    pool.drainRemoteFrees();
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Thread owned pools are built and grown without launching Kokkos kernels", "[ThreadOwnedMultiPool][allocation][growth]") {
+    constexpr unsigned NUM_THREADS = 4;
+
+    ThreadOwnedMultiPool pool(1);
+    ForbiddenLaunchCounter launches;
+    std::vector<char> allZero(NUM_THREADS, false);
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < NUM_THREADS; t++) {
+        threads.emplace_back([&pool, &allZero, t] {
+            kokkosLaunchesForbidden = true;
+
+            // Larger than a thread's first sub-pool, so every thread's pool has to grow
+            auto view = pool.allocateView<VeryLargeStruct>(1);
+            allZero[t] = std::all_of(view(0).data, view(0).data + sizeof(VeryLargeStruct), [](uint8_t byte) { return byte == 0; });
+
+            pool.deallocateView(view);
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(launches.getNumLaunches() == 0);
+    REQUIRE(std::all_of(allZero.begin(), allZero.end(), [](char zero) { return zero; }));
+    REQUIRE(pool.getNumChunks() >= pool.getNumThreads() * (1 + EXPECTED_CHUNKS(VeryLargeStruct)));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Sharded pool falls back to neighbouring shards", "[ShardedMultiPool][allocation][deallocation]") {
+    ShardedMultiPool<> pool(TEST_POOL_SIZE, 2);
+    unsigned homeShard = pool.getHomeShard();
+
+    REQUIRE(pool.getNumShards() == 2);
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * 2);
+
+    auto home = pool.allocateView<VeryLargeStruct>(1);
+    auto neighbour = pool.allocateView<VeryLargeStruct>(1);
+    REQUIRE(pool.getShardOf(reinterpret_cast<uint8_t*>(home.data())) == homeShard);
+    REQUIRE(pool.getShardOf(reinterpret_cast<uint8_t*>(neighbour.data())) == (homeShard + 1) % 2);
+    REQUIRE(pool.getNumChunks() == TEST_POOL_SIZE * 2);
+
+    // Every shard is full, so the home shard grows
+    auto grown = pool.allocateView<VeryLargeStruct>(1);
+    REQUIRE(pool.getShardOf(reinterpret_cast<uint8_t*>(grown.data())) == homeShard);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (EXPECTED_CHUNKS(VeryLargeStruct) * 3), 3);
+
+    pool.deallocateView(home);
+    pool.deallocateView(neighbour);
+    pool.deallocateView(grown);
+
+    SECTION("Shards grow on other threads without launching Kokkos kernels") {
+        constexpr unsigned NUM_THREADS = 4;
+
+        ForbiddenLaunchCounter launches;
+        unsigned numChunksBefore = pool.getNumChunks();
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < NUM_THREADS; t++) {
+            threads.emplace_back([&pool] {
+                kokkosLaunchesForbidden = true;
+
+                // Twice the largest sub-pool of any shard, so the home shard has to grow
+                auto view = pool.allocateView<VeryLargeStruct>(4);
+                pool.deallocateView(view);
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        REQUIRE(launches.getNumLaunches() == 0);
+        REQUIRE(pool.getNumChunks() > numChunksBefore);
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
+
+    SECTION("Threads allocate and free concurrently") {
+        constexpr unsigned NUM_THREADS = 4;
+        constexpr unsigned ALLOCATIONS_PER_THREAD = 1000;
+
+        std::atomic<bool> running = true;
+        unsigned mostAllocationsSeen = 0;
+
+        // Statistics are read without locks while the allocating threads run
+        std::thread monitor([&pool, &running, &mostAllocationsSeen] {
+            while (running) {
+                mostAllocationsSeen = std::max(mostAllocationsSeen, pool.getNumAllocations());
+            }
+        });
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < NUM_THREADS; t++) {
+            threads.emplace_back([&pool] {
+                std::vector<Kokkos::View<int*, Kokkos::HostSpace>> views;
+
+                for (unsigned i = 0; i < ALLOCATIONS_PER_THREAD; i++) {
+                    views.push_back(pool.allocateView<int>(i % 64 + 1));
+                    views.back()(0) = i;
+                }
+
+                for (auto& view : views) {
+                    pool.deallocateView(view);
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        running = false;
+        monitor.join();
+
+        REQUIRE(mostAllocationsSeen <= NUM_THREADS * ALLOCATIONS_PER_THREAD);
+    }
+
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Bulk allocation reserves one block for a whole batch", "[MultiPool][allocation][bulk]") {
+    HostMultiPool pool(TEST_POOL_SIZE);
+
+    Kokkos::View<size_t*, Kokkos::HostSpace> sizes("sizes", 4);
+    Kokkos::View<size_t*, Kokkos::HostSpace> offsets("offsets", 5);
+    sizes(0) = 10;
+    sizes(1) = 0;
+    sizes(2) = 300;
+    sizes(3) = 17;
+
+    uint8_t* batch = pool.allocateBulk(sizes, offsets, 16);
+    REQUIRE(batch != nullptr);
+
+    std::vector<size_t> expectedOffsets = {0, 16, 16, 320, 352};
+    for (size_t i = 0; i < expectedOffsets.size(); i++) {
+        REQUIRE(offsets(i) == expectedOffsets[i]);
+    }
+
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, MemoryPool::getRequiredChunks(offsets(4)), 1);
+
+    for (size_t i = 0; i < sizes.extent(0); i++) {
+        std::fill(batch + offsets(i), batch + offsets(i) + sizes(i), static_cast<uint8_t>(i));
+    }
+
+    REQUIRE(batch[offsets(2) + 299] == 2);
+    REQUIRE(batch[offsets(3)] == 3);
+
+    pool.deallocate(batch);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Team arenas sub-allocate from one block per team", "[TeamArena][allocation]") {
+    using TeamPolicy = Kokkos::TeamPolicy<Kokkos::DefaultHostExecutionSpace>;
+    constexpr int LEAGUE_SIZE = 4;
+    constexpr size_t BYTES_PER_TEAM = 1024;
+    constexpr size_t HEADER_SIZE = TeamArena<ShardedMultiPool<>, TeamPolicy::member_type>::HEADER_SIZE;
+
+    // Every shard holds the blocks of the whole league, so no team ever has to grow the pool inside the kernel
+    ShardedMultiPool<> pool(HostMemoryPool::getRequiredChunks(HEADER_SIZE + BYTES_PER_TEAM) * LEAGUE_SIZE, 2);
+    const unsigned numChunksBefore = pool.getNumChunks();
+    Kokkos::View<int*, Kokkos::HostSpace> failures("failures", LEAGUE_SIZE);
+
+    Kokkos::parallel_for(TeamPolicy(LEAGUE_SIZE, Kokkos::AUTO), [&pool, failures](const TeamPolicy::member_type& team) {
+        TeamArena arena(pool, team, BYTES_PER_TEAM);
+        using Arena = decltype(arena);
+
+        // Rounded down, since every allocation is padded up to the alignment and the last share would not fit otherwise
+        size_t bytesPerThread = (BYTES_PER_TEAM / team.team_size()) & ~(Arena::ALIGNMENT - 1);
+        size_t leftover = BYTES_PER_TEAM - (bytesPerThread * team.team_size());
+
+        auto values = arena.allocateView<int>(bytesPerThread / sizeof(int));
+        if (values.data()) {
+            for (size_t i = 0; i < values.extent(0); i++) {
+                values(i) = team.league_rank();
+            }
+        } else {
+            Kokkos::atomic_add(&failures(team.league_rank()), 1);
+        }
+
+        team.team_barrier();
+
+        // Every thread took its share, so only the leftover is free until the arena is reset
+        if (arena.allocate(leftover + 1) != nullptr) {
+            Kokkos::atomic_add(&failures(team.league_rank()), 1);
+        }
+
+        arena.reset();
+
+        Kokkos::single(Kokkos::PerTeam(team), [&] {
+            if (arena.allocate(BYTES_PER_TEAM) == nullptr) {
+                failures(team.league_rank())++;
+            }
+        });
+    });
+
+    for (int rank = 0; rank < LEAGUE_SIZE; rank++) {
+        REQUIRE(failures(rank) == 0);
+    }
+
+    REQUIRE(pool.getNumChunks() == numChunksBefore);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Budgeted pool queues allocations until memory is freed", "[BudgetedMultiPool][allocation][deallocation]") {
+    BudgetedMultiPool<> pool(TEST_POOL_SIZE, TEST_POOL_SIZE);
+
+    auto first = pool.allocateAsync(sizeof(LargeStruct));
+    REQUIRE(first.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    uint8_t* firstData = first.get();
+
+    auto second = pool.allocateAsync(sizeof(VeryLargeStruct));
+    auto third = pool.allocateAsync(sizeof(int)); // Would fit, but waits its turn behind the second
+
+    REQUIRE(pool.getNumWaiters() == 2);
+    REQUIRE(pool.tryAllocate(sizeof(int)) == nullptr);
+    REQUIRE(third.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+
+    std::thread consumer([&pool, firstData] {
+        pool.deallocate(firstData);
+    });
+
+    uint8_t* secondData = second.get(); // Woken by the consumer's deallocate
+    consumer.join();
+
+    REQUIRE(pool.getNumWaiters() == 1);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, EXPECTED_CHUNKS(VeryLargeStruct), 1);
+
+    pool.deallocate(secondData);
+    uint8_t* thirdData = third.get();
+    REQUIRE(pool.getNumWaiters() == 0);
+
+    pool.deallocate(thirdData);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+
+    SECTION("Requests larger than the budget fail") {
+        auto tooLarge = pool.allocateAsync(sizeof(VeryLargeStruct) + 1);
+        REQUIRE_THROWS_AS(tooLarge.get(), std::bad_alloc);
+    }
+
+    SECTION("Views become available once their memory is") {
+        auto view = pool.allocateViewAsync<LargeStruct>(2).get();
+        auto pending = pool.allocateViewAsync<int>(1);
+
+        pool.deallocateView(view);
+        pool.deallocateView(pending.get());
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    }
+}
+
+TEST_CASE("Prefaulted pools report the time it took", "[MultiPool][prefault]") {
+    constexpr size_t POOL_CHUNKS = 1024;
+
+    HostMultiPool plainPool(POOL_CHUNKS);
+    REQUIRE(plainPool.getPrefaultTime() == std::chrono::nanoseconds::zero());
+
+    PoolOptions options;
+    options.prefault = true;
+    options.lock = true;
+
+    HostMultiPool pool(POOL_CHUNKS, options);
+    REQUIRE(pool.getPrefaultTime() > std::chrono::nanoseconds::zero());
+
+    // Prefaulting must not disturb the known zero contents
+    auto view = pool.allocateView<int>(POOL_CHUNKS * MemoryPool::DEFAULT_CHUNK_SIZE / sizeof(int), true);
+    for (size_t i = 0; i < view.size(); i++) {
+        REQUIRE(view(i) == 0);
+    }
+
+    view(0) = 1;
+    pool.deallocateView(view);
+
+    HostMemoryPool lockedPool(POOL_CHUNKS, options);
+    if (lockedPool.isLocked()) { // mlock fails when RLIMIT_MEMLOCK is too low
+        uint8_t* data = lockedPool.allocate(POOL_CHUNKS * MemoryPool::DEFAULT_CHUNK_SIZE);
+        data[0] = 1;
+        lockedPool.deallocate(data);
+
+        REQUIRE(lockedPool.purgeFreeChunks() == 0);
+
+        // The lock moves with the pool, so only the new owner unlocks the pages
+        HostMemoryPool movedPool(std::move(lockedPool));
+        REQUIRE(movedPool.isLocked());
+        REQUIRE_FALSE(lockedPool.isLocked());
+    }
+
+    // A range inside a single page shares it with its neighbours, so there is nothing it may lock on its own
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    std::vector<uint8_t> buffer(pageSize * 2);
+    uint8_t* pageStart = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(buffer.data()) + pageSize - 1) / pageSize * pageSize);
+    REQUIRE_FALSE(PageLock(pageStart + 1, pageSize - 2).isLocked());
+}
+
+TEST_CASE("Cache coloring rotates the start of large allocations", "[MemoryPool][allocation][coloring]") {
+    constexpr unsigned CACHE_COLORS = 4;
+    constexpr size_t LARGE_SIZE = 4096;
+
+    PoolOptions options;
+    options.cacheColors = CACHE_COLORS;
+    options.coloringThreshold = LARGE_SIZE;
+
+    SECTION("The chunks skipped to reach a color belong to the allocation") {
+        HostMemoryPool pool(256, options);
+        std::vector<uint8_t*> allocations;
+        std::set<size_t> colors;
+
+        for (unsigned i = 0; i < CACHE_COLORS; i++) {
+            allocations.push_back(pool.allocate(LARGE_SIZE));
+            colors.insert((reinterpret_cast<uintptr_t>(allocations.back()) / MemoryPool::DEFAULT_CHUNK_SIZE) % CACHE_COLORS);
+            REQUIRE(pool.getAllocationSize(allocations.back()) == MemoryPool::getRequiredChunks(LARGE_SIZE));
+        }
+
+        REQUIRE(colors.size() == CACHE_COLORS);
+        REQUIRE(pool.getNumAllocations() == CACHE_COLORS);
+        REQUIRE(pool.getNumAllocatedChunks() >= MemoryPool::getRequiredChunks(LARGE_SIZE) * CACHE_COLORS);
+        REQUIRE(pool.getNumFreeChunks() == pool.getNumChunks() - pool.getNumAllocatedChunks());
+        REQUIRE(pool.getNumFreeFragments() == 1);
+
+        for (uint8_t* data : allocations) {
+            pool.deallocate(data);
+        }
+
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+        REQUIRE(pool.getNumFreeFragments() == 1);
+    }
+
+    SECTION("Allocations with no room to shift are placed uncolored") {
+        HostMemoryPool pool(MemoryPool::getRequiredChunks(LARGE_SIZE), options);
+
+        for (unsigned i = 0; i < CACHE_COLORS; i++) {
+            uint8_t* data = pool.allocate(LARGE_SIZE);
+            REQUIRE(data);
+            EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, MemoryPool::getRequiredChunks(LARGE_SIZE), 1);
+
+            pool.deallocate(data);
+            EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+        }
+    }
+}
+
+TEST_CASE("Sized deallocation frees the same chunks as unsized", "[MultiPool][deallocation][sized]") {
+    HostMultiPool pool(TEST_POOL_SIZE);
+
+    uint8_t* small = pool.allocate(sizeof(int));
+    uint8_t* large = pool.allocate(sizeof(VeryLargeStruct)); // Lands in a second sub-pool
+    auto view = pool.allocateView<LargeStruct>(1);
+
+    REQUIRE(pool.getAllocationSize(large) == EXPECTED_CHUNKS(VeryLargeStruct));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (1 + EXPECTED_CHUNKS(VeryLargeStruct) + EXPECTED_CHUNKS(LargeStruct)), 3);
+
+    pool.deallocate(large, sizeof(VeryLargeStruct));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, (1 + EXPECTED_CHUNKS(LargeStruct)), 2);
+
+    pool.deallocateView(view); // Sized by the view
+    pool.deallocate(small, sizeof(int));
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+    REQUIRE(pool.getNumFreeFragments() == 2);
+}
+
+TEST_CASE("Zero size allocations take one chunk and can be freed", "[MultiPool][allocation][deallocation][zero-size]") {
+    PoolOptions options;
+    options.quickListDepth = GENERATE(0u, 2u);
+
+    HostMultiPool pool(TEST_POOL_SIZE, options);
+
+    uint8_t* unsized = pool.allocate(0);
+    uint8_t* sized = pool.allocate(0);
+    auto view = pool.allocateView<int>(0);
+
+    REQUIRE(unsized != sized);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 3, 3);
+
+    pool.deallocate(unsized);
+    pool.deallocate(sized, 0);
+    pool.deallocateView(view);
+    EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, 0, 0);
+}
+
+TEST_CASE("Placement policies pick different free runs", "[MemoryPool][allocation][placement]") {
+    // Free runs of 2, 4 and 3 chunks at 0, 3 and 8, with single allocated chunks between them
+    auto makePool = [](PlacementPolicy placement) {
+        PoolOptions options;
+        options.placement = placement;
+
+        auto pool = std::make_unique<HostMemoryPool>(11, options);
+        std::vector<uint8_t*> spacers;
+
+        for (size_t runSize : {2, 1, 4, 1, 3}) {
+            spacers.push_back(pool->allocate(runSize * MemoryPool::DEFAULT_CHUNK_SIZE));
+        }
+
+        pool->deallocate(spacers[0]);
+        pool->deallocate(spacers[2]);
+        pool->deallocate(spacers[4]);
+
+        REQUIRE(pool->getNumFreeFragments() == 3);
+        return pool;
+    };
+
+    auto allocateChunks = [](HostMemoryPool& pool, size_t numChunks) {
+        uint8_t* data = pool.allocate(numChunks * MemoryPool::DEFAULT_CHUNK_SIZE);
+        return data ? static_cast<size_t>(data - pool.getBaseAddress()) / MemoryPool::DEFAULT_CHUNK_SIZE : pool.getNumChunks();
+    };
+
+    SECTION("Best fit") {
+        auto pool = makePool(PlacementPolicy::BestFit);
+        REQUIRE(allocateChunks(*pool, 2) == 0);
+        REQUIRE(allocateChunks(*pool, 3) == 8);
+    }
+
+    SECTION("First fit") {
+        auto pool = makePool(PlacementPolicy::FirstFit);
+        REQUIRE(allocateChunks(*pool, 1) == 0);
+        REQUIRE(allocateChunks(*pool, 3) == 3);
+    }
+
+    SECTION("Next fit") {
+        auto pool = makePool(PlacementPolicy::NextFit);
+        REQUIRE(allocateChunks(*pool, 1) == 0); // The spacers stopped at the end, so this wraps around
+        REQUIRE(allocateChunks(*pool, 2) == 3);
+
+        pool->deallocate(pool->getBaseAddress());
+        REQUIRE(allocateChunks(*pool, 1) == 5); // Continues from the last allocation instead of the start
+    }
+
+    SECTION("Worst fit") {
+        auto pool = makePool(PlacementPolicy::WorstFit);
+        REQUIRE(allocateChunks(*pool, 1) == 3);
+        REQUIRE(pool->getNumFreeFragments() == 3);
+        REQUIRE(allocateChunks(*pool, 4) == pool->getNumChunks());
+    }
+}
+
+TEST_CASE("Quick lists hand back recently freed blocks of the same size", "[MemoryPool][allocation][deallocation][quicklist]") {
+    constexpr size_t CHUNK_SIZE = MemoryPool::DEFAULT_CHUNK_SIZE;
+
+    PoolOptions options;
+    options.quickListDepth = 2;
+    options.maxQuickListChunks = 4;
+
+    SECTION("Freed blocks stay apart and are reused last in, first out") {
+        HostMemoryPool pool(16, options);
+
+        uint8_t* a = pool.allocate(2 * CHUNK_SIZE);
+        uint8_t* b = pool.allocate(2 * CHUNK_SIZE);
+
+        pool.deallocate(a);
+        pool.deallocate(b);
+
+        REQUIRE(pool.getNumFreeChunks() == 16);
+        REQUIRE(pool.getNumFreeFragments() == 3);
+        REQUIRE(pool.getNumDirtyFreeChunks() == 4);
+
+        REQUIRE(pool.allocate(2 * CHUNK_SIZE) == b);
+        REQUIRE(pool.allocate(2 * CHUNK_SIZE) == a);
+        REQUIRE(pool.getNumFreeFragments() == 1);
+    }
+
+    SECTION("Overflowing a list merges it into the free sets") {
+        HostMemoryPool pool(16, options);
+
+        uint8_t* a = pool.allocate(CHUNK_SIZE);
+        uint8_t* b = pool.allocate(CHUNK_SIZE);
+        uint8_t* c = pool.allocate(CHUNK_SIZE);
+
+        pool.deallocate(a);
+        pool.deallocate(b);
+        pool.deallocate(c);
+
+        REQUIRE(pool.getNumFreeChunks() == 16);
+        REQUIRE(pool.getNumFreeFragments() == 3); // a and b merged with each other, c still on its own
+        REQUIRE(pool.allocate(CHUNK_SIZE) == c);
+    }
+
+    SECTION("An allocation that finds no free run merges every list") {
+        HostMemoryPool pool(4, options);
+
+        uint8_t* a = pool.allocate(CHUNK_SIZE);
+        uint8_t* b = pool.allocate(3 * CHUNK_SIZE);
+
+        pool.deallocate(a);
+        pool.deallocate(b);
+
+        REQUIRE(pool.getNumFreeFragments() == 2);
+        REQUIRE(pool.allocate(4 * CHUNK_SIZE) == a);
+        REQUIRE(pool.getNumFreeChunks() == 0);
+    }
+
+    SECTION("Zeroed allocations clear quick listed blocks") {
+        HostMemoryPool pool(16, options);
+
+        uint8_t* block = pool.allocate(CHUNK_SIZE);
+        std::fill(block, block + CHUNK_SIZE, uint8_t{1});
+        pool.deallocate(block);
+
+        uint8_t* zeroed = pool.allocateZeroed(CHUNK_SIZE);
+        REQUIRE(zeroed == block);
+        REQUIRE(std::all_of(zeroed, zeroed + CHUNK_SIZE, [](uint8_t byte) { return byte == 0; }));
+    }
+
+    SECTION("Larger blocks are coalesced right away") {
+        HostMemoryPool pool(16, options);
+
+        pool.deallocate(pool.allocate(5 * CHUNK_SIZE));
+        REQUIRE(pool.getNumFreeFragments() == 1);
+    }
+}
+
+TEST_CASE("Deferred frees are coalesced in one sweep", "[MemoryPool][deallocation][deferred]") {
+    constexpr size_t CHUNK_SIZE = MemoryPool::DEFAULT_CHUNK_SIZE;
+
+    PoolOptions options;
+    options.deferredFrees = 4;
+
+    SECTION("A full buffer merges every deferred free") {
+        HostMemoryPool pool(16, options);
+        std::vector<uint8_t*> blocks;
+
+        for (int i = 0; i < 4; i++) {
+            blocks.push_back(pool.allocate(CHUNK_SIZE));
+        }
+
+        pool.deallocate(blocks[2]);
+        pool.deallocate(blocks[0]);
+        pool.deallocate(blocks[1]);
+
+        REQUIRE(pool.getNumFreeChunks() == 15);
+        REQUIRE(pool.getNumFreeFragments() == 4);
+        REQUIRE(pool.getNumDirtyFreeChunks() == 3);
+
+        pool.deallocate(blocks[3]);
+
+        REQUIRE(pool.getNumFreeChunks() == 16);
+        REQUIRE(pool.getNumFreeFragments() == 1);
+    }
+
+    SECTION("Deferred frees and free runs that alternate merge into one run") {
+        options.deferredFrees = 2;
+        HostMemoryPool pool(6, options);
+        std::vector<uint8_t*> blocks;
+
+        for (int i = 0; i < 6; i++) {
+            blocks.push_back(pool.allocate(CHUNK_SIZE));
+        }
+
+        pool.deallocate(blocks[1]);
+        pool.deallocate(blocks[3]);
+        REQUIRE(pool.getNumFreeFragments() == 2);
+
+        pool.deallocate(blocks[4]);
+        pool.deallocate(blocks[2]);
+        REQUIRE(pool.getNumFreeFragments() == 1);
+        REQUIRE(pool.allocate(4 * CHUNK_SIZE) == blocks[1]);
+    }
+
+    SECTION("An allocation that finds no free run merges the buffer") {
+        HostMemoryPool pool(4, options);
+        std::vector<uint8_t*> blocks;
+
+        for (int i = 0; i < 4; i++) {
+            blocks.push_back(pool.allocate(CHUNK_SIZE));
+        }
+
+        pool.deallocate(blocks[1]);
+        pool.deallocate(blocks[2]);
+
+        REQUIRE(pool.allocate(2 * CHUNK_SIZE) == blocks[1]);
+        REQUIRE(pool.getNumFreeChunks() == 0);
+    }
+}
+
+TEST_CASE("Segmented arrays grow without a contiguous run", "[SegmentedArray][allocation][deallocation]") {
+    constexpr unsigned LOG2_SEGMENT_SIZE = 5; // 32 ints, exactly one chunk per segment
+    constexpr size_t NUMBER_OF_ELEMENTS = 200;
+
+    HostMultiPool pool(16);
+
+    // Every other chunk stays allocated, so no free run is longer than one chunk
+    std::vector<uint8_t*> chunks;
+    for (int i = 0; i < 16; i++) {
+        chunks.push_back(pool.allocate(1));
+    }
+
+    std::vector<uint8_t*> held;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (i % 2) {
+            pool.deallocate(chunks[i]);
+        } else {
+            held.push_back(chunks[i]);
+        }
+    }
+
+    REQUIRE(pool.getNumFreeFragments() == 8);
+    REQUIRE(pool.getNumFreeChunks() == 8);
+
+    {
+        SegmentedArray<int> array(pool, 8, LOG2_SEGMENT_SIZE);
+        auto accessor = array.getAccessor();
+
+        for (size_t i = 0; i < NUMBER_OF_ELEMENTS; i++) {
+            array.pushBack(static_cast<int>(i));
+        }
+
+        REQUIRE(array.getSize() == NUMBER_OF_ELEMENTS);
+        REQUIRE(array.getNumSegments() == 7);
+        REQUIRE(array.getCapacity() * sizeof(int) > MemoryPool::DEFAULT_CHUNK_SIZE);
+        REQUIRE(pool.getNumChunks() == 16); // Never needed the pool to grow
+        REQUIRE(pool.getNumFreeChunks() == 0);
+
+        // Taken before the array grew, and still sees every segment
+        Kokkos::parallel_for(Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, NUMBER_OF_ELEMENTS), [=](size_t i) {
+            accessor(i) *= 2;
+        });
+
+        size_t sum = 0;
+        Kokkos::parallel_reduce(Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, NUMBER_OF_ELEMENTS), [=](size_t i, size_t& partialSum) {
+            partialSum += accessor(i);
+        }, sum);
+
+        REQUIRE(sum == NUMBER_OF_ELEMENTS * (NUMBER_OF_ELEMENTS - 1));
+        REQUIRE(array(NUMBER_OF_ELEMENTS - 1) == 2 * (NUMBER_OF_ELEMENTS - 1));
+
+        REQUIRE_THROWS_AS(array.resize(8 * 32 + 1), std::length_error);
+        REQUIRE_THROWS_AS(array.reserve(std::numeric_limits<size_t>::max()), std::length_error);
+
+        array.resize(40);
+        REQUIRE(array.getNumSegments() == 7);
+
+        array.shrinkToFit();
+        REQUIRE(array.getNumSegments() == 2);
+        REQUIRE(array.getCapacity() == 64);
+        REQUIRE(pool.getNumAllocations() == held.size() + 3);
+    }
+
+    REQUIRE(pool.getNumAllocations() == held.size());
+
+    // Rejected before anything is taken from the pool
+    REQUIRE_THROWS_AS(SegmentedArray<int>(pool, std::numeric_limits<size_t>::max() / sizeof(int*) + 1), std::length_error);
+    REQUIRE_THROWS_AS(SegmentedArray<int>(pool, 8, std::numeric_limits<size_t>::digits), std::invalid_argument);
+    REQUIRE_THROWS_AS(SegmentedArray<int>(pool, 8, std::numeric_limits<size_t>::digits - 1), std::invalid_argument);
+    REQUIRE(pool.getNumAllocations() == held.size());
+
+    for (uint8_t* chunk : held) {
+        pool.deallocate(chunk);
+    }
+
+    REQUIRE(pool.getNumAllocations() == 0);
+}
+
+TEST_CASE("Benchmarks", "[!benchmark]") {
+    constexpr size_t NUMBER_OF_VIEWS = 100'000;
+    constexpr size_t SIZE_OF_VIEWS = 1024;
+
+    const size_t TOTAL_CHUNK_SIZE = MemoryPool::getRequiredChunks(sizeof(int) * SIZE_OF_VIEWS) * NUMBER_OF_VIEWS;
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    BENCHMARK(fmt::format(loc, "Kokkos Allocating {:L} Views of {:L} ints", NUMBER_OF_VIEWS, SIZE_OF_VIEWS)) {
+        std::vector<Kokkos::View<int[SIZE_OF_VIEWS]>> views(NUMBER_OF_VIEWS);
+
+        for (auto &view: views) {
+            view = Kokkos::View<int[SIZE_OF_VIEWS]>("view", SIZE_OF_VIEWS);
+            REQUIRE(view.size() == SIZE_OF_VIEWS);
+        }
+
+        return views.size();
+    };
+
+    BENCHMARK(fmt::format(loc, "MultiPool Allocation {:L} Views of {:L} ints", NUMBER_OF_VIEWS, SIZE_OF_VIEWS)) {
+        MultiPool pool(TOTAL_CHUNK_SIZE);
+        std::vector<Kokkos::View<int[SIZE_OF_VIEWS]>> views(NUMBER_OF_VIEWS);
+
+        for (auto &view: views) {
+            view = pool.allocateView<int>(SIZE_OF_VIEWS);
+            REQUIRE(view.size() == SIZE_OF_VIEWS);
+        }
+
+        EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, TOTAL_CHUNK_SIZE, NUMBER_OF_VIEWS);
+        return views.size();
+    };
+}
+
+TEST_CASE("Fragmentation Benchmarks", "[!benchmark][fragmentation]") {
+    constexpr size_t NUMBER_OF_VIEWS = 10'000;
+    constexpr size_t SIZE_OF_VIEWS = 1024;
+    const size_t INITIAL_CHUNKS_PER_VIEW = MemoryPool::getRequiredChunks(sizeof(int) * SIZE_OF_VIEWS);
+
+    const size_t TOTAL_CHUNK_SIZE = INITIAL_CHUNKS_PER_VIEW * NUMBER_OF_VIEWS;
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    int deallocStep = GENERATE(range(2, 5));
+    int reallocFill = GENERATE_COPY(range(1, deallocStep));
+
+    std::string kokkosBenchmarkName = fmt::format(loc, "Kokkos Allocation of {:L} Views of {:L} ints with {:L} free chunks between allocations and {:L} chunks requested in following allocations", NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW);
+
+    SECTION(kokkosBenchmarkName) {
+        // CSV output
+        INFO(fmt::format("csvKokkos,{},{},{},{}", NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW));
+
+        BENCHMARK(std::move(kokkosBenchmarkName)) {
+            std::vector<Kokkos::View<int *>> views(NUMBER_OF_VIEWS);
+
+            for (auto &view: views) {
+                view = Kokkos::View<int *>("view", SIZE_OF_VIEWS);
+                REQUIRE(view.size() == SIZE_OF_VIEWS);
+            }
+
+            for (unsigned i = 0; i < views.size(); i++) {
+                if (i % deallocStep != 0) {
+                    CAPTURE(i);
+                    CAPTURE(deallocStep);
+                    CAPTURE(reallocFill);
+                    views[i] = Kokkos::View<int *>("view", SIZE_OF_VIEWS * reallocFill);
+                    REQUIRE(views[i].size() == SIZE_OF_VIEWS * reallocFill);
+                }
+            }
+
+            return views.size();
+        };
+    }
+
+    auto [placement, placementName] = GENERATE(table<PlacementPolicy, std::string>({
+        {PlacementPolicy::BestFit, "Best Fit"},
+        {PlacementPolicy::FirstFit, "First Fit"},
+        {PlacementPolicy::NextFit, "Next Fit"},
+        {PlacementPolicy::WorstFit, "Worst Fit"}
+    }));
+
+    std::string multiPoolBenchmarkName = fmt::format(loc, "Fragmented {} MultiPool Allocation of {:L} Views of {:L} ints with {:L} free chunks between allocations and {:L} chunks requested in following allocations", placementName, NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW);
+
+    SECTION(multiPoolBenchmarkName) {
+        // CSV output
+        INFO(fmt::format("csvMultiPool {},{},{},{},{}", placementName, NUMBER_OF_VIEWS, SIZE_OF_VIEWS, (deallocStep - 1) * INITIAL_CHUNKS_PER_VIEW, reallocFill * INITIAL_CHUNKS_PER_VIEW));
+
+        PoolOptions options;
+        options.placement = placement;
+
+        BENCHMARK(std::move(multiPoolBenchmarkName)) {
+            MultiPool pool(TOTAL_CHUNK_SIZE, options);
+            std::vector<Kokkos::View<int *>> views(NUMBER_OF_VIEWS);
+
+            for (auto &view: views) {
+                view = pool.allocateView<int>(SIZE_OF_VIEWS);
+                REQUIRE(view.size() == SIZE_OF_VIEWS);
+            }
+
+            EXPECT_CHUNKS_AND_ALLOCS_IN_POOL(pool, TOTAL_CHUNK_SIZE, NUMBER_OF_VIEWS);
+
+            for (unsigned i = 0; i < views.size(); i++) {
+                if (i % deallocStep != 0) {
+                    CAPTURE(i);
+                    CAPTURE(deallocStep);
+                    pool.deallocateView<int>(views[i]);
+                    unsigned expectedChunks =
+                            (((i / deallocStep) * (deallocStep - 1)) + (i % deallocStep)) * INITIAL_CHUNKS_PER_VIEW;
+                    REQUIRE(pool.getNumFreeChunks() == expectedChunks);
+                }
+            }
+
+            REQUIRE(pool.getNumFreeChunks() ==
+                    static_cast<int>(NUMBER_OF_VIEWS * (static_cast<float>(deallocStep - 1) / deallocStep)) *
+                    INITIAL_CHUNKS_PER_VIEW);
+
+            for (unsigned i = 0; i < views.size(); i++) {
+                if (i % deallocStep != 0) {
+                    CAPTURE(i);
+                    CAPTURE(deallocStep);
+                    CAPTURE(reallocFill);
+                    views[i] = pool.allocateView<int>(SIZE_OF_VIEWS * reallocFill);
+                    REQUIRE(views[i].size() == SIZE_OF_VIEWS * reallocFill);
+                }
+            }
+
+            return views.size();
+        };
+    }
+}
+
+TEST_CASE("NUMA Benchmarks", "[!benchmark][numa]") {
+    constexpr size_t SIZE_OF_VIEWS = 64 * 1024 * 1024 / sizeof(double);
+    const size_t TOTAL_CHUNK_SIZE = HostMemoryPool::getRequiredChunks(sizeof(double) * SIZE_OF_VIEWS);
+
+    NumaMultiPool pool(TOTAL_CHUNK_SIZE);
+    const unsigned localNode = pool.getNodeIds().front();
+    const unsigned remoteNode = pool.getNodeIds()[1 % pool.getNumNodes()];
+
+    // Sums on this thread alone, pinned to the local node. Kokkos' host threads may run on any node, which would make
+    // "local" and "remote" meaningless.
+    NumaNodeBinding binding(localNode);
+    INFO(fmt::format("{} NUMA node(s), pages bound: {}, thread bound: {}", pool.getNumNodes(), pool.isBound(), binding.isBound()));
+
+    auto sumView = [](Kokkos::View<double*, Kokkos::HostSpace> view) {
+        double sum = 0;
+
+        for (size_t i = 0; i < view.size(); i++) {
+            sum += view(i);
+        }
+
+        return sum;
+    };
+
+    auto localView = pool.allocateView<double>(SIZE_OF_VIEWS, localNode);
+    auto remoteView = pool.allocateView<double>(SIZE_OF_VIEWS, remoteNode);
+
+    BENCHMARK(fmt::format("Reading {} MiB from local NUMA node {}", sizeof(double) * SIZE_OF_VIEWS >> 20, localNode)) {
+        return sumView(localView);
+    };
+
+    BENCHMARK(fmt::format("Reading {} MiB from remote NUMA node {}", sizeof(double) * SIZE_OF_VIEWS >> 20, remoteNode)) {
+        return sumView(remoteView);
+    };
+
+    pool.deallocateView(localView);
+    pool.deallocateView(remoteView);
+}
+
+TEST_CASE("Snapshot Benchmarks", "[!benchmark][snapshot]") {
+    constexpr size_t NUMBER_OF_VIEWS = 10'000;
+    constexpr size_t SIZE_OF_VIEWS = 1024;
+    const size_t TOTAL_CHUNK_SIZE = HostMemoryPool::getRequiredChunks(sizeof(int) * SIZE_OF_VIEWS) * NUMBER_OF_VIEWS;
+    const std::string path = (std::filesystem::temp_directory_path() / ("kokkos_memory_pool_snapshot_benchmark_" + std::to_string(getpid()))).string();
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    HostMultiPool pool(TOTAL_CHUNK_SIZE);
+    std::vector<Kokkos::View<int*, Kokkos::HostSpace>> views(NUMBER_OF_VIEWS);
+
+    for (auto &view: views) {
+        view = pool.allocateView<int>(SIZE_OF_VIEWS);
+    }
+
+    // Free every other view so the snapshot has gaps to skip
+    for (size_t i = 1; i < views.size(); i += 2) {
+        pool.deallocateView(views[i]);
+    }
+
+    BENCHMARK(fmt::format(loc, "Writing {:L} Views of {:L} ints individually", NUMBER_OF_VIEWS / 2, SIZE_OF_VIEWS)) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        for (size_t i = 0; i < views.size(); i += 2) {
+            file.write(reinterpret_cast<const char*>(views[i].data()), views[i].size() * sizeof(int));
+        }
+
+        return file.tellp();
+    };
+
+    BENCHMARK(fmt::format(loc, "MultiPool snapshot of {:L} Views of {:L} ints", NUMBER_OF_VIEWS / 2, SIZE_OF_VIEWS)) {
+        pool.snapshot(path);
+        return pool.getNumAllocations();
+    };
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Object Pool Benchmarks", "[!benchmark][ObjectPool]") {
+    constexpr size_t NUMBER_OF_OBJECTS = 100'000;
+    struct Vector4 {
+        double data[4];
+    };
+
+    const size_t TOTAL_CHUNK_SIZE = HostMemoryPool::getRequiredChunks(sizeof(Vector4)) * NUMBER_OF_OBJECTS;
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    HostMultiPool pool(TOTAL_CHUNK_SIZE);
+    ObjectPool<Vector4> objects(pool);
+    std::vector<Vector4*> objectPtrs(NUMBER_OF_OBJECTS);
+    std::vector<Kokkos::View<Vector4*, Kokkos::HostSpace>> views(NUMBER_OF_OBJECTS);
+
+    BENCHMARK(fmt::format(loc, "MultiPool allocateView and deallocateView of {:L} objects", NUMBER_OF_OBJECTS)) {
+        for (auto& view : views) {
+            view = pool.allocateView<Vector4>(1);
+        }
+
+        for (auto& view : views) {
+            pool.deallocateView(view);
+        }
+
+        return views.size();
+    };
+
+    BENCHMARK(fmt::format(loc, "ObjectPool construct and destroy of {:L} objects", NUMBER_OF_OBJECTS)) {
+        for (auto& ptr : objectPtrs) {
+            ptr = objects.construct();
+        }
+
+        for (auto& ptr : objectPtrs) {
+            objects.destroy(ptr);
+        }
+
+        return objectPtrs.size();
+    };
+}
+
+TEST_CASE("Cache Coloring Benchmarks", "[!benchmark][coloring]") {
+    constexpr size_t ARRAY_SIZE = 1 << 20; // Doubles per array, so uncolored arrays sit a power of two apart
+    constexpr unsigned CACHE_COLORS = 32;
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    for (unsigned cacheColors : {0u, CACHE_COLORS}) {
+        PoolOptions options;
+        options.cacheColors = cacheColors;
+
+        HostMultiPool pool(HostMemoryPool::getRequiredChunks(sizeof(double) * ARRAY_SIZE) * 3 + CACHE_COLORS * 3, options);
+        auto a = pool.allocateView<double>(ARRAY_SIZE);
+        auto b = pool.allocateView<double>(ARRAY_SIZE);
+        auto c = pool.allocateView<double>(ARRAY_SIZE);
+
+        Kokkos::deep_copy(b, 1.0);
+        Kokkos::deep_copy(c, 2.0);
+
+        BENCHMARK(fmt::format(loc, "Triad over {:L} doubles with {} cache colors", ARRAY_SIZE, cacheColors)) {
+            Kokkos::parallel_for(Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, ARRAY_SIZE), KOKKOS_LAMBDA(size_t i) {
+                a(i) = b(i) + 3.0 * c(i);
+            });
+            Kokkos::fence();
+
+            return a(0);
+        };
+
+        pool.deallocateView(a);
+        pool.deallocateView(b);
+        pool.deallocateView(c);
+    }
+}
+
+TEST_CASE("Quick List Benchmarks", "[!benchmark][quicklist]") {
+    constexpr size_t NUMBER_OF_BLOCKS = 10'000;
+    constexpr size_t BLOCK_SIZE = 4 * MemoryPool::DEFAULT_CHUNK_SIZE;
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    for (unsigned quickListDepth : {0u, 16u}) {
+        PoolOptions options;
+        options.quickListDepth = quickListDepth;
+
+        HostMultiPool pool((HostMemoryPool::getRequiredChunks(BLOCK_SIZE) + 1) * NUMBER_OF_BLOCKS, options);
+        std::vector<uint8_t*> blocks(NUMBER_OF_BLOCKS);
+        std::vector<uint8_t*> spacers(NUMBER_OF_BLOCKS);
+
+        for (size_t i = 0; i < NUMBER_OF_BLOCKS; i++) {
+            blocks[i] = pool.allocate(BLOCK_SIZE);
+            spacers[i] = pool.allocate(1);
+        }
+
+        // Freeing every other single chunk spacer leaves every block but the first a free neighbour too small to hold a
+        // block. Without a quick list each free merges with it, and the allocation after splits the merged run again.
+        for (size_t i = 1; i < NUMBER_OF_BLOCKS; i += 2) {
+            pool.deallocate(spacers[i]);
+        }
+
+        BENCHMARK(fmt::format(loc, "Free and reallocate {:L} blocks of {:L} bytes with quick list depth {}", NUMBER_OF_BLOCKS, BLOCK_SIZE, quickListDepth)) {
+            for (auto& block : blocks) {
+                pool.deallocate(block);
+                block = pool.allocate(BLOCK_SIZE);
+            }
+
+            return blocks.size();
+        };
+    }
+}
+
+TEST_CASE("Deferred Coalescing Benchmarks", "[!benchmark][deferred]") {
+    constexpr size_t NUMBER_OF_BLOCKS = 10'000;
+    constexpr size_t BLOCK_SIZE = 2 * MemoryPool::DEFAULT_CHUNK_SIZE;
+    constexpr size_t STRIDE = 7'919; // Prime, so freeing every STRIDE-th block modulo the count visits each one once
+
+    std::locale loc("en_US.UTF-8"); // For thousands separator
+
+    for (size_t deferredFrees : {size_t{0}, size_t{256}}) {
+        PoolOptions options;
+        options.deferredFrees = deferredFrees;
+
+        HostMultiPool pool(HostMemoryPool::getRequiredChunks(BLOCK_SIZE) * NUMBER_OF_BLOCKS, options);
+        std::vector<uint8_t*> blocks(NUMBER_OF_BLOCKS);
+
+        for (auto& block : blocks) {
+            block = pool.allocate(BLOCK_SIZE);
+        }
+
+        BENCHMARK(fmt::format(loc, "Churn of {:L} blocks of {:L} bytes freed in scattered order with {:L} deferred frees", NUMBER_OF_BLOCKS, BLOCK_SIZE, deferredFrees)) {
+            for (size_t i = 0; i < NUMBER_OF_BLOCKS; i++) {
+                pool.deallocate(blocks[(i * STRIDE) % NUMBER_OF_BLOCKS]);
+            }
+
+            for (auto& block : blocks) {
+                block = pool.allocate(BLOCK_SIZE);
+            }
+
+            return pool.getNumFreeFragments();
+        };
+    }
+}